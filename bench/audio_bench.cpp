@@ -0,0 +1,135 @@
+// Benchmarks the audio pipeline on the host, see [env:native] in platformio.ini. Each track is played through the
+// same stages as run_audio() in main.cpp (samples, volume, fft, intensity) as fast as possible, and the average time
+// per stage is reported in microseconds per frame along with the frame rate. A checksum of the LED intensities is
+// also printed, so a change to the output shows up even when the timing does not.
+//
+// Usage: program [--max-us <us>] [track.wav ...]
+//      --max-us: exit with an error if any track takes longer than this per frame, so the benchmark can be used as a
+//          regression gate. The limit only makes sense for the machine it was measured on.
+//      track.wav: recordings to play back, see WavAudioSource in AudioSource.h. If none are given, a synthetic tone
+//          with noise is used instead.
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "AudioProcessor.h"
+#include "AudioSource.h"
+#include "Constants.h"
+#include "Utils.h"
+
+#define BENCH_TONE_SEC 10  // length of the synthetic tone used when no tracks are given
+#define BENCH_PASSES 5     // times each track is played, the fastest pass is reported to reduce noise from the host
+
+enum BenchStage {
+    STAGE_SAMPLES,
+    STAGE_VOLUME,
+    STAGE_FFT,
+    STAGE_INTENSITY,
+    STAGE_MAX,
+};
+
+static const char *STAGE_NAMES[STAGE_MAX] = {"samples", "volume", "fft", "intensity"};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Runs num_frames frames through the pipeline BENCH_PASSES times in a row, so the source should loop, and prints the
+// timing of the fastest pass. The checksum covers the first pass only. Returns the total time per frame of the fastest
+// pass in microseconds, or a negative value if there was no audio to run.
+static double run_track(const char *name, AudioProcessor &ap, uint32_t num_frames) {
+    if (!ap.is_active() || num_frames == 0) {
+        print("%s: skipped, no audio\n", name);
+        return -1;
+    }
+    ap.set_filterbank(AUDIO_FILTERBANK[MODE_AUDIO_SNAKE_GRID]);
+
+    double best_us[STAGE_MAX] = {0};
+    double best_total_us = 0;
+    uint32_t checksum = 0;
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double stage_us[STAGE_MAX] = {0};
+        for (uint32_t frame = 0; frame < num_frames; frame++) {
+            bench_clock::time_point times[STAGE_MAX + 1];
+            times[0] = bench_clock::now();
+            ap.get_audio_samples_gapless();
+            times[1] = bench_clock::now();
+            ap.update_volume();
+            times[2] = bench_clock::now();
+            ap.run_fft();
+            times[3] = bench_clock::now();
+            ap.calc_intensity(NUM_LEDS / 2);
+            times[4] = bench_clock::now();
+
+            for (int i = 0; i < STAGE_MAX; i++) {
+                stage_us[i] += std::chrono::duration<double, std::micro>(times[i + 1] - times[i]).count();
+            }
+
+            if (pass == 0) {
+                int *intensity = ap.get_intensity();
+                for (int i = 0; i < NUM_LEDS / 2; i++) {
+                    checksum = checksum * 31 + uint32_t(intensity[i]);
+                }
+            }
+        }
+
+        double total_us = 0;
+        for (int i = 0; i < STAGE_MAX; i++) {
+            total_us += stage_us[i];
+        }
+        if (pass == 0 || total_us < best_total_us) {
+            best_total_us = total_us;
+            memcpy(best_us, stage_us, sizeof(best_us));
+        }
+    }
+
+    print("%s: %d frames, ", name, num_frames);
+    for (int i = 0; i < STAGE_MAX; i++) {
+        print("%s: %.1f us, ", STAGE_NAMES[i], best_us[i] / num_frames);
+    }
+    best_total_us /= num_frames;
+    print("total: %.1f us/frame, %.0f frames/sec, checksum: %08x\n", best_total_us, 1e6 / best_total_us, checksum);
+
+    return best_total_us;
+}
+
+int main(int argc, char **argv) {
+    double max_us = 0;
+    int first_track = 1;
+    if (argc > 2 && strcmp(argv[1], "--max-us") == 0) {
+        max_us = atof(argv[2]);
+        first_track = 3;
+    }
+
+    print("Audio pipeline: FFT_SAMPLES %d, FFT_HOP_SAMPLES %d, %d frames/sec needed, %s FFT\n", FFT_SAMPLES,
+          FFT_HOP_SAMPLES, FFTS_PER_SEC,
+#ifdef FFT_FIXED_POINT
+          "fixed-point"
+#else
+          "float"
+#endif
+    );
+
+    bool failed = false;
+    double worst_us = 0;
+    if (first_track >= argc) {
+        ToneAudioSource tone = ToneAudioSource(AUDIO_TONE_FREQ, 0.5, 0.01, false);
+        AudioProcessor ap = AudioProcessor(false, false, true, true, &tone);
+        double total_us = run_track("tone", ap, BENCH_TONE_SEC * FFTS_PER_SEC);
+        failed |= (total_us < 0);
+        worst_us = max(worst_us, total_us);
+    }
+    for (int i = first_track; i < argc; i++) {
+        WavAudioSource wav = WavAudioSource(argv[i], true, false);
+        AudioProcessor ap = AudioProcessor(false, false, true, true, &wav);  // initializes the source
+        double total_us = run_track(argv[i], ap, wav.length() / FFT_HOP_SAMPLES);
+        failed |= (total_us < 0);
+        worst_us = max(worst_us, total_us);
+    }
+
+    if (max_us > 0 && worst_us > max_us) {
+        print("FAIL: %.1f us/frame is over the limit of %.1f us/frame\n", worst_us, max_us);
+        failed = true;
+    }
+
+    return failed ? 1 : 0;
+}
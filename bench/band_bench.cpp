@@ -0,0 +1,167 @@
+// Benchmarks the banding in calc_intensity_simple() on the host, see [env:native_bands] in platformio.ini. The FFT
+// bins are summed into 16, 32 and 64 log-spaced audio bands, set up as in _setup_audio_bins(), in two ways:
+//      before: the original loop, which tests every FFT bin against every band, rounding the band edges each time
+//      after: _apply_bin_ranges() with the precomputed bin range for each band
+// Both are run on the same random spectra, and the average time per frame is reported from the fastest of
+// BENCH_PASSES. The program exits with an error if the two disagree on any band, or if the ranges built here for
+// NUM_AUDIO_BANDS differ from the AudioProcessor's own.
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "AudioSource.h"
+#include "BeatDetector.h"
+#include "Constants.h"
+#include "FFTWindow.h"
+#include "Filterbank.h"
+#include "FixedFFT.h"
+#include "Resampler.h"
+#include "Utils.h"
+#include "fft.h"
+
+// The AudioProcessor, with its private members opened up so _apply_bin_ranges() and the band ranges can be used
+// directly. src/AudioProcessor.cpp is left out of this environment's build.
+#define private public
+#include "AudioProcessor.cpp"
+#undef private
+
+#define BENCH_MAX_BANDS 64
+#define BENCH_FRAMES 2000  // random spectra per pass
+#define BENCH_PASSES 5     // passes over the spectra, the fastest pass is reported to reduce noise from the host
+
+static const int BENCH_BANDS[] = {16, 32, 64};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// The band edges for num_bands bands, in FFT bins, as calculated by _setup_audio_bins()
+static void setup_band_edges(int num_bands, float *low_bins, float *high_bins) {
+    double lowest_freq = LOWEST_FREQ_BAND;
+    double highest_freq = min(double(HIGHEST_FREQ_BAND), I2S_SAMPLE_RATE / 2.0);
+    double freq_mult_per_band = pow(double(highest_freq) / lowest_freq, 1.0 / (num_bands - 1));
+    double bin_width = double(I2S_SAMPLE_RATE) / FFT_SAMPLES;
+    double nbins = FFT_SAMPLES / 2.0 - 1;
+
+    float center_bins[BENCH_MAX_BANDS];
+    for (int band = 0; band < num_bands; band++) {
+        center_bins[band] = float(lowest_freq * pow(freq_mult_per_band, band)) / bin_width;
+    }
+    for (int band = 0; band < num_bands - 1; band++) {
+        high_bins[band] = (center_bins[band + 1] - center_bins[band]) / 2.0 + center_bins[band];
+    }
+    high_bins[num_bands - 1] = nbins;
+    for (int band = num_bands - 1; band >= 1; band--) {
+        low_bins[band] = high_bins[band - 1];
+    }
+    low_bins[0] = 0;
+}
+
+// The bin ranges for the band edges, as built by _setup_audio_bins() without AUDIO_BAND_EDGE_WEIGHTS. Returns the
+// number of ranges.
+static int setup_band_ranges(int num_bands, const float *low_bins, const float *high_bins, bin_range_t *ranges) {
+    int num_ranges = 0;
+    for (int band = 0; band < num_bands; band++) {
+        int start = (band == 0) ? 0 : int(round(low_bins[band])) + 1;
+        int end = int(round(high_bins[band]));
+        if (end >= start) {
+            ranges[num_ranges++] = {.out = uint16_t(band), .start = uint16_t(start), .end = uint16_t(end),
+                                    .start_weight = 1.0, .end_weight = 1.0};
+        }
+    }
+    return num_ranges;
+}
+
+// The banding loop from calc_intensity_simple() before the bin ranges
+static void band_before(const float *v_real, int num_bands, const float *low_bins, const float *high_bins,
+                        float *fft_bin) {
+    for (int i = 0; i < FFT_SAMPLES / 2; i++) {
+        if (i == 0)
+            fft_bin[i] += v_real[i];
+        else {
+            for (int j = 0; j < num_bands; j++) {
+                if (i > int(round(low_bins[j])) && i <= int(round(high_bins[j]))) fft_bin[j] += v_real[i];
+            }
+        }
+    }
+}
+
+// Times one band count, returning false if the two versions disagree
+static bool run_bands(AudioProcessor &ap, int num_bands, const float *spectra) {
+    float low_bins[BENCH_MAX_BANDS], high_bins[BENCH_MAX_BANDS];
+    bin_range_t ranges[BENCH_MAX_BANDS];
+    setup_band_edges(num_bands, low_bins, high_bins);
+    int num_ranges = setup_band_ranges(num_bands, low_bins, high_bins, ranges);
+
+    bool matched = true;
+    if (num_bands == NUM_AUDIO_BANDS) {  // check the ranges built here against the AudioProcessor's own
+        matched &= (num_ranges == ap._num_band_ranges);
+        for (int r = 0; matched && r < num_ranges; r++) {
+            const bin_range_t &a = ranges[r];
+            const bin_range_t &b = ap._band_ranges[r];
+            matched &= (a.out == b.out) && (a.start == b.start) && (a.end == b.end) &&
+                       (a.start_weight == b.start_weight) && (a.end_weight == b.end_weight);
+        }
+    }
+
+    double best_us[2] = {0};
+    float volatile sink = 0;  // keeps the compiler from dropping the loops
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double pass_us[2] = {0};
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            const float *v_real = &spectra[frame * (FFT_SAMPLES / 2)];
+            float before[FFT_SAMPLES / 2] = {0};  // the original loop writes the 0th bin into band 0 via fft_bin[0]
+            float after[BENCH_MAX_BANDS] = {0};
+
+            bench_clock::time_point t0 = bench_clock::now();
+            band_before(v_real, num_bands, low_bins, high_bins, before);
+            bench_clock::time_point t1 = bench_clock::now();
+            memcpy(ap._v_real, v_real, sizeof(float) * (FFT_SAMPLES / 2));
+            bench_clock::time_point t2 = bench_clock::now();
+            ap._apply_bin_ranges(ranges, num_ranges, after);
+            bench_clock::time_point t3 = bench_clock::now();
+
+            pass_us[0] += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            pass_us[1] += std::chrono::duration<double, std::micro>(t3 - t2).count();
+            sink = sink + before[num_bands - 1] + after[num_bands - 1];
+
+            if (pass == 0) {
+                matched &= (memcmp(before, after, sizeof(float) * num_bands) == 0);
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pass == 0 || pass_us[i] < best_us[i]) {
+                best_us[i] = pass_us[i];
+            }
+        }
+    }
+
+    print("%d bands: %d non-empty, before: %.2f us/frame, after: %.2f us/frame, %.1fx faster, outputs %s\n",
+          num_bands, num_ranges, best_us[0] / BENCH_FRAMES, best_us[1] / BENCH_FRAMES, best_us[0] / best_us[1],
+          matched ? "match" : "DIFFER");
+    return matched;
+}
+
+int main() {
+    print("Audio bands: FFT_SAMPLES %d, %d bins, %d frames\n", FFT_SAMPLES, FFT_SAMPLES / 2, BENCH_FRAMES);
+
+    static float spectra[BENCH_FRAMES * (FFT_SAMPLES / 2)];
+    srand(1);
+    for (int i = 0; i < BENCH_FRAMES * (FFT_SAMPLES / 2); i++) {
+        spectra[i] = float(rand()) / RAND_MAX;
+    }
+
+    ToneAudioSource tone = ToneAudioSource(AUDIO_TONE_FREQ, 0.5);
+    AudioProcessor ap = AudioProcessor(false, false, false, false, &tone);
+
+    bool passed = true;
+    for (int num_bands : BENCH_BANDS) {
+        passed &= run_bands(ap, num_bands, spectra);
+    }
+
+    if (!passed) {
+        print("FAIL: the bin ranges do not match the original banding\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// Scores the beat detector against a corpus of synthetic click tracks on the host, see [env:native_beat] in
+// platformio.ini. Each track is run through the whole audio pipeline, as in run_audio() in main.cpp, and the onsets
+// and beats it reports are matched against the known click times:
+//      onsets: detections within BENCH_ONSET_TOL_MS of a click, scored as an F-score (precision vs. recall)
+//      beats: the beat phase wrapping around, within BENCH_BEAT_TOL_MS of a beat, scored as an F-score after the
+//          first BENCH_SETTLE_SEC seconds, which the tempo estimate needs to fill its history
+//      tempo: the tempo at the end of the track, counted as correct if within BENCH_TEMPO_TOL of the truth
+//
+// Usage: program [--min-f <f>]
+//      --min-f: exit with an error if the mean onset or beat F-score is below this, so the benchmark can be used as
+//          a regression gate.
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "AudioProcessor.h"
+#include "AudioSource.h"
+#include "Constants.h"
+#include "Utils.h"
+
+#define BENCH_TRACK_SEC 30       // length of each click track
+#define BENCH_SETTLE_SEC 5       // beats are only scored after this many seconds
+#define BENCH_ONSET_TOL_MS 50    // onset matching tolerance
+#define BENCH_BEAT_TOL_MS 70     // beat matching tolerance
+#define BENCH_TEMPO_TOL 0.04     // relative tempo tolerance
+#define BENCH_NOISE_FLOOR 0.002  // amplitude of the background noise, relative to full scale
+
+enum ClickSound {
+    CLICK_NOISE,  // short burst of white noise, like a metronome
+    CLICK_KICK,   // low sine with a falling pitch, like a kick drum
+    CLICK_BLIP,   // short high sine
+};
+
+typedef struct click_track {
+    const char *name;
+    double bpm;
+    ClickSound sound;
+    double level;        // amplitude of each click, relative to full scale
+    int subdivisions;    // clicks per beat, only the first of which is on the beat
+    double tone_level;   // amplitude of a sustained 220 Hz tone under the clicks, which should not be detected
+    double noise_level;  // amplitude of white noise under the clicks
+} click_track_t;
+
+static const click_track_t CORPUS[] = {
+    {"metronome_60", 60, CLICK_NOISE, 0.5, 1, 0, BENCH_NOISE_FLOOR},
+    {"metronome_90", 90, CLICK_NOISE, 0.5, 1, 0, BENCH_NOISE_FLOOR},
+    {"metronome_120", 120, CLICK_NOISE, 0.5, 1, 0, BENCH_NOISE_FLOOR},
+    {"metronome_174", 174, CLICK_NOISE, 0.5, 1, 0, BENCH_NOISE_FLOOR},
+    {"kick_100", 100, CLICK_KICK, 0.8, 1, 0, BENCH_NOISE_FLOOR},
+    {"kick_128", 128, CLICK_KICK, 0.8, 1, 0, BENCH_NOISE_FLOOR},
+    {"blip_140", 140, CLICK_BLIP, 0.3, 1, 0, BENCH_NOISE_FLOOR},
+    {"blip_eighths_110", 110, CLICK_BLIP, 0.3, 2, 0, BENCH_NOISE_FLOOR},
+    {"kick_over_tone_95", 95, CLICK_KICK, 0.5, 1, 0.2, BENCH_NOISE_FLOOR},
+    {"metronome_in_noise_120", 120, CLICK_NOISE, 0.5, 1, 0, 0.05},
+};
+
+// Generates a click track, see click_track_t. read() returns immediately, so the pipeline runs flat out.
+class ClickTrackAudioSource : public AudioSource {
+   public:
+    ClickTrackAudioSource(const click_track_t &track) : _track(track) {
+    }
+
+    bool init() override {
+        _pos = 0;
+        return true;
+    }
+
+    int read(int32_t *buffer, int num_samples) override {
+        double full_scale = double((1 << (I2S_MIC_BIT_DEPTH - 1)) - 1) * (1 << (32 - I2S_MIC_BIT_DEPTH));
+        double click_period = 60.0 * I2S_SAMPLE_RATE / (_track.bpm * _track.subdivisions);
+
+        for (int i = 0; i < num_samples; i++, _pos++) {
+            double t = double(_pos) / I2S_SAMPLE_RATE;
+            double val = _track.tone_level * sin(2 * PI * 220 * t);
+            val += _track.noise_level * (double(random(-32768, 32768)) / 32768);
+
+            // Time since the last click, and whether it was on the beat
+            long click = long(_pos / click_period);
+            double click_t = (_pos - click * click_period) / I2S_SAMPLE_RATE;
+            double level = (click % _track.subdivisions == 0) ? _track.level : _track.level / 2;
+            val += level * _click_sample(click_t);
+
+            buffer[i] = int32_t(round(constrain(val, -1.0, 1.0) * full_scale));
+        }
+
+        return num_samples;
+    }
+
+    // Returns the times of every click (or only those on the beat) in the first duration_sec seconds.
+    std::vector<double> click_times(double duration_sec, bool beats_only) {
+        std::vector<double> times;
+        int step = beats_only ? _track.subdivisions : 1;
+        double click_sec = 60.0 / (_track.bpm * _track.subdivisions);
+        for (int click = 0; click * click_sec < duration_sec; click += step) {
+            times.push_back(click * click_sec);
+        }
+        return times;
+    }
+
+   private:
+    // Returns the sample of the click sound t seconds after it starts
+    double _click_sample(double t) {
+        switch (_track.sound) {
+            case CLICK_NOISE:
+                return exp(-t / 0.005) * (double(random(-32768, 32768)) / 32768);
+            case CLICK_KICK:
+                return exp(-t / 0.05) * sin(2 * PI * (60 * t + 40 * 0.02 * (1 - exp(-t / 0.02))));  // 100 Hz falling to 60 Hz
+            case CLICK_BLIP:
+                return (t < 0.02) ? sin(2 * PI * 2000 * t) : 0;
+        }
+        return 0;
+    }
+
+    click_track_t _track;
+    uint32_t _pos = 0;  // index of the next sample
+};
+
+// Matches each detection to the nearest unmatched reference time within tol_sec, ignoring anything before
+// start_sec, and returns the F-score (the harmonic mean of precision and recall).
+static double f_score(const std::vector<double> &detected, const std::vector<double> &reference, double tol_sec,
+                      double start_sec, double *precision, double *recall) {
+    std::vector<bool> matched(reference.size(), false);
+    int num_detected = 0;
+    int num_reference = 0;
+    int num_matched = 0;
+
+    for (double ref : reference) {
+        num_reference += (ref >= start_sec);
+    }
+    for (double det : detected) {
+        if (det < start_sec) {
+            continue;
+        }
+        num_detected++;
+
+        int best = -1;
+        for (size_t i = 0; i < reference.size(); i++) {
+            if (!matched[i] && reference[i] >= start_sec && fabs(det - reference[i]) <= tol_sec &&
+                (best < 0 || fabs(det - reference[i]) < fabs(det - reference[best]))) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            matched[best] = true;
+            num_matched++;
+        }
+    }
+
+    *precision = (num_detected > 0) ? double(num_matched) / num_detected : 0;
+    *recall = (num_reference > 0) ? double(num_matched) / num_reference : 0;
+    return (num_matched > 0) ? 2 * *precision * *recall / (*precision + *recall) : 0;
+}
+
+int main(int argc, char **argv) {
+    double min_f = 0;
+    if (argc > 2 && strcmp(argv[1], "--min-f") == 0) {
+        min_f = atof(argv[2]);
+    }
+
+    print("Beat detection: %d frames/sec, %d frame flux history\n", FFTS_PER_SEC, BEAT_FLUX_HISTORY);
+
+    double total_onset_f = 0;
+    double total_beat_f = 0;
+    int tempo_correct = 0;
+    int num_tracks = ARRAY_SIZE(CORPUS);
+    for (const click_track_t &track : CORPUS) {
+        ClickTrackAudioSource source = ClickTrackAudioSource(track);
+        AudioProcessor ap = AudioProcessor(false, false, true, true, &source);
+
+        // Each frame is timed at its newest sample, which is the earliest an onset in it could be reported
+        std::vector<double> onsets;
+        std::vector<double> beats;
+        double last_phase = 0;
+        uint32_t num_frames = BENCH_TRACK_SEC * I2S_SAMPLE_RATE / FFT_HOP_SAMPLES;
+        for (uint32_t frame = 0; frame < num_frames; frame++) {
+            ap.get_audio_samples_gapless();
+            ap.update_volume();
+            ap.run_fft();
+
+            double t = double(frame + 1) * FFT_HOP_SAMPLES / I2S_SAMPLE_RATE;
+            if (ap.is_onset()) {
+                onsets.push_back(t);
+            }
+            double phase = ap.get_beat_phase();
+            if (ap.get_tempo() > 0 && phase < last_phase) {  // the phase wrapped around, so a beat just passed
+                beats.push_back(t);
+            }
+            last_phase = phase;
+        }
+
+        double onset_p, onset_r, beat_p, beat_r;
+        double onset_f = f_score(onsets, source.click_times(BENCH_TRACK_SEC, false), BENCH_ONSET_TOL_MS / 1000.0, 0,
+                                 &onset_p, &onset_r);
+        double beat_f = f_score(beats, source.click_times(BENCH_TRACK_SEC, true), BENCH_BEAT_TOL_MS / 1000.0,
+                                BENCH_SETTLE_SEC, &beat_p, &beat_r);
+        double tempo = ap.get_tempo();
+        bool tempo_ok = fabs(tempo - track.bpm) <= BENCH_TEMPO_TOL * track.bpm;
+
+        print("%s: onset F %.2f (P %.2f, R %.2f), beat F %.2f (P %.2f, R %.2f), tempo %.1f/%.0f bpm %s\n", track.name,
+              onset_f, onset_p, onset_r, beat_f, beat_p, beat_r, tempo, track.bpm, tempo_ok ? "ok" : "WRONG");
+
+        total_onset_f += onset_f;
+        total_beat_f += beat_f;
+        tempo_correct += tempo_ok;
+    }
+
+    double mean_onset_f = total_onset_f / num_tracks;
+    double mean_beat_f = total_beat_f / num_tracks;
+    print("mean onset F %.3f, mean beat F %.3f, tempo correct %d/%d\n", mean_onset_f, mean_beat_f, tempo_correct,
+          num_tracks);
+
+    if (min_f > 0 && (mean_onset_f < min_f || mean_beat_f < min_f)) {
+        print("FAIL: F-score is below the limit of %.3f\n", min_f);
+        return 1;
+    }
+    return 0;
+}
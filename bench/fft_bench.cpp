@@ -0,0 +1,176 @@
+// Compares the fixed-point FFT path (FFT_FIXED_POINT in Constants.h) with the float path on the host, see
+// [env:native_fft] in platformio.ini. Both builds of the pipeline are fed the same samples frame by frame, and the
+// float path is taken as the reference for:
+//      amplitudes: the post-processed FFT amplitudes, as an SNR in dB over all bins and frames
+//      intensities: the LED intensities, as an SNR in dB and the mean and largest difference in brightness levels
+//          (values near MIN_BRIGHT_UPDATE can land either side of it, so single LEDs can differ by much more than
+//          the mean)
+//      timing: the time spent in run_fft() by each path, in microseconds per frame, from the fastest of BENCH_PASSES
+//
+// Usage: program [--min-snr <dB>] [track.wav ...]
+//      --min-snr: exit with an error if the amplitude SNR of any track is below this, so the benchmark can be used
+//          as a regression gate.
+//      track.wav: recordings to play back, see WavAudioSource in AudioSource.h. If none are given, a synthetic tone
+//          with noise is used instead.
+
+#include "fft_bench.h"
+
+#include <Arduino.h>
+
+#include "AudioProcessor.h"
+#include "AudioSource.h"
+#include "Constants.h"
+#include "Utils.h"
+
+#ifdef FFT_FIXED_POINT
+#error "fft_bench builds both FFT paths itself, so FFT_FIXED_POINT must not be defined"
+#endif
+
+#define BENCH_TONE_SEC 10  // length of the synthetic tone used when no tracks are given
+#define BENCH_PASSES 5     // times each track is played, the fastest pass is reported to reduce noise from the host
+
+FFTBenchPath *new_float_path(AudioSource *source) {
+    return new FFTBenchPathImpl<AudioProcessor>(source);
+}
+
+// Hands out the samples of one frame, so both paths can read the same samples from a single source
+class FrameAudioSource : public AudioSource {
+   public:
+    bool init() override {
+        return true;
+    }
+
+    int read(int32_t *buffer, int num_samples) override {
+        num_samples = min(num_samples, FFT_HOP_SAMPLES - _pos);
+        memcpy(buffer, &samples[_pos], num_samples * sizeof(int32_t));
+        _pos += num_samples;
+        return num_samples;
+    }
+
+    // Starts handing out samples from the beginning of the frame again
+    void rewind() {
+        _pos = 0;
+    }
+
+    int32_t samples[FFT_HOP_SAMPLES] = {0};
+
+   private:
+    int _pos = 0;
+};
+
+// Signal to noise ratio of a test signal against a reference, accumulated over many frames
+class SNR {
+   public:
+    void add(double ref, double test) {
+        _signal += ref * ref;
+        _noise += (test - ref) * (test - ref);
+    }
+
+    double get_db() {
+        return (_noise > 0) ? 10 * log10(_signal / _noise) : INFINITY;
+    }
+
+   private:
+    double _signal = 0;
+    double _noise = 0;
+};
+
+// Runs num_frames frames from source through both paths BENCH_PASSES times in a row, so the source should loop, and
+// prints the accuracy of the fixed-point path over the first pass and the timing of the fastest pass. Returns the
+// amplitude SNR in dB, or NAN if there was no audio to run.
+static double run_track(const char *name, AudioSource *source, uint32_t num_frames) {
+    FrameAudioSource frame_source_float, frame_source_fixed;
+    FFTBenchPath *paths[2] = {new_float_path(&frame_source_float), new_fixed_point_path(&frame_source_fixed)};
+    FrameAudioSource *frame_sources[2] = {&frame_source_float, &frame_source_fixed};
+
+    double snr_db = NAN;
+    if (!paths[0]->is_active() || num_frames == 0) {
+        print("%s: skipped, no audio\n", name);
+    } else {
+        SNR amplitude_snr, intensity_snr;
+        uint64_t sum_intensity_diff = 0;
+        int max_intensity_diff = 0;
+        double best_us[2] = {0};
+        for (int pass = 0; pass < BENCH_PASSES; pass++) {
+            double pass_us[2] = {0};
+            for (uint32_t frame = 0; frame < num_frames; frame++) {
+                source->read(frame_source_float.samples, FFT_HOP_SAMPLES);
+                memcpy(frame_source_fixed.samples, frame_source_float.samples, sizeof(frame_source_fixed.samples));
+                for (int p = 0; p < 2; p++) {
+                    frame_sources[p]->rewind();
+                    pass_us[p] += paths[p]->run_frame();
+                }
+
+                if (pass == 0) {
+                    float *ref = paths[0]->get_fft_amplitudes();
+                    float *test = paths[1]->get_fft_amplitudes();
+                    for (int i = 0; i < FFT_SAMPLES / 2 - 1; i++) {
+                        amplitude_snr.add(ref[i], test[i]);
+                    }
+
+                    int *ref_intensity = paths[0]->get_intensity();
+                    int *test_intensity = paths[1]->get_intensity();
+                    for (int i = 0; i < NUM_LEDS / 2; i++) {
+                        intensity_snr.add(ref_intensity[i], test_intensity[i]);
+                        int diff = abs(test_intensity[i] - ref_intensity[i]);
+                        sum_intensity_diff += diff;
+                        max_intensity_diff = max(max_intensity_diff, diff);
+                    }
+                }
+            }
+
+            for (int p = 0; p < 2; p++) {
+                if (pass == 0 || pass_us[p] < best_us[p]) {
+                    best_us[p] = pass_us[p];
+                }
+            }
+        }
+
+        snr_db = amplitude_snr.get_db();
+        double mean_intensity_diff = double(sum_intensity_diff) / (num_frames * NUM_LEDS / 2);
+        print("%s: %d frames, amplitude SNR: %.1f dB, intensity SNR: %.1f dB, intensity diff mean: %.2f max: %d, ",
+              name, num_frames, snr_db, intensity_snr.get_db(), mean_intensity_diff, max_intensity_diff);
+        print("run_fft float: %.1f us/frame, fixed-point: %.1f us/frame\n", best_us[0] / num_frames,
+              best_us[1] / num_frames);
+    }
+
+    delete paths[0];
+    delete paths[1];
+    return snr_db;
+}
+
+int main(int argc, char **argv) {
+    double min_snr_db = -INFINITY;
+    int first_track = 1;
+    if (argc > 2 && strcmp(argv[1], "--min-snr") == 0) {
+        min_snr_db = atof(argv[2]);
+        first_track = 3;
+    }
+
+    print("FFT paths: FFT_SAMPLES %d, FFT_HOP_SAMPLES %d, %s window\n", FFT_SAMPLES, FFT_HOP_SAMPLES,
+          get_fft_window_name(FFT_WINDOW));
+
+    bool failed = false;
+    double worst_snr_db = INFINITY;
+    if (first_track >= argc) {
+        ToneAudioSource tone = ToneAudioSource(AUDIO_TONE_FREQ, 0.5, 0.01, false);
+        tone.init();
+        double snr_db = run_track("tone", &tone, BENCH_TONE_SEC * FFTS_PER_SEC);
+        failed |= isnan(snr_db);
+        worst_snr_db = min(worst_snr_db, snr_db);
+    }
+    for (int i = first_track; i < argc; i++) {
+        WavAudioSource wav = WavAudioSource(argv[i], true, false);
+        bool ok = wav.init();
+        double snr_db = run_track(argv[i], &wav, ok ? wav.length() / FFT_HOP_SAMPLES : 0);
+        failed |= isnan(snr_db);
+        worst_snr_db = min(worst_snr_db, snr_db);
+    }
+
+    if (worst_snr_db < min_snr_db) {
+        print("FAIL: amplitude SNR of %.1f dB is under the limit of %.1f dB\n", worst_snr_db, min_snr_db);
+        failed = true;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef _FFT_BENCH_H
+#define _FFT_BENCH_H
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "AudioSource.h"
+#include "Constants.h"
+
+// One build of the audio pipeline for bench/fft_bench.cpp. The float and fixed-point FFT paths are separate builds
+// of the AudioProcessor, so each is wrapped in a FFTBenchPath to run them side by side in one program.
+class FFTBenchPath {
+   public:
+    virtual ~FFTBenchPath() {}
+
+    // Runs one frame through the pipeline, as run_audio() in main.cpp does, and returns the time spent in run_fft()
+    // in microseconds.
+    virtual double run_frame() = 0;
+
+    virtual float *get_fft_amplitudes() = 0;
+    virtual int *get_intensity() = 0;
+    virtual bool is_active() = 0;
+};
+
+template <class Processor>
+class FFTBenchPathImpl : public FFTBenchPath {
+   public:
+    FFTBenchPathImpl(AudioSource *source) : _ap(false, false, true, true, source) {
+        _ap.set_filterbank(AUDIO_FILTERBANK[MODE_AUDIO_SNAKE_GRID]);
+    }
+
+    double run_frame() override {
+        _ap.get_audio_samples_gapless();
+        _ap.update_volume();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        _ap.run_fft();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        _ap.calc_intensity(NUM_LEDS / 2);
+        return std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    float *get_fft_amplitudes() override { return _ap.get_fft_amplitudes(); }
+    int *get_intensity() override { return _ap.get_intensity(); }
+    bool is_active() override { return _ap.is_active(); }
+
+   private:
+    Processor _ap;
+};
+
+// The two builds of the pipeline, see bench/fft_bench.cpp and bench/fft_bench_fixed.cpp.
+FFTBenchPath *new_float_path(AudioSource *source);
+FFTBenchPath *new_fixed_point_path(AudioSource *source);
+
+#endif  // _FFT_BENCH_H
@@ -0,0 +1,12 @@
+// A second build of the AudioProcessor with the fixed-point FFT, for bench/fft_bench.cpp. The class is renamed so it
+// can be linked into the same program as the float build.
+#define FFT_FIXED_POINT
+#define AudioProcessor FixedPointAudioProcessor
+#include "AudioProcessor.cpp"
+#undef AudioProcessor
+
+#include "fft_bench.h"
+
+FFTBenchPath *new_fixed_point_path(AudioSource *source) {
+    return new FFTBenchPathImpl<FixedPointAudioProcessor>(source);
+}
@@ -0,0 +1,218 @@
+// Validates the Filterbank against a dense reference implementation on the host and times it, see
+// [env:native_filterbank] in platformio.ini. Each scale is built at the lengths the AudioProcessor asks for
+// (NUM_LEDS / 2 for calc_intensity() and GRID_W for calc_intensity_simple()), over the same FFT bins and frequency
+// range as _apply_filterbank(), and compared with the reference:
+//      reference: a full num_filters x num_bins weight matrix, with the band edges and triangular weights computed
+//          separately from Filterbank.cpp, in double precision. As in the Filterbank, a filter that covers no bin
+//          takes the bin nearest its center at full weight
+//      weight error: the largest difference between any weight and the reference, found by applying the filterbank
+//          to a unit impulse in each bin
+//      output error: the largest difference between the outputs and the reference on random spectra, relative to the
+//          largest reference output
+//      timing: the time per frame of Filterbank::apply() and of the dense reference, from the fastest of BENCH_PASSES
+// The program exits with an error if either error is over BENCH_MAX_ERROR or any filter has no weight.
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Constants.h"
+#include "Filterbank.h"
+#include "Utils.h"
+
+#define BENCH_NUM_BINS (FFT_SAMPLES / 2 - 1)  // FFT amplitudes passed to the filterbank, the DC term is skipped
+#define BENCH_FRAMES 1000                      // random spectra per pass
+#define BENCH_PASSES 5   // passes over the spectra, the fastest pass is reported to reduce noise from the host
+#define BENCH_MAX_ERROR 1e-5  // float rounding of the weights and sums
+
+static const int BENCH_LENGTHS[] = {NUM_LEDS / 2, GRID_W};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// The scales, written in other but equivalent forms to those in Filterbank.cpp: mel as the natural log form of the
+// HTK formula, Bark as Traunmüller's formula without the corrections at either end, and ERB-rate from Glasberg &
+// Moore
+static double ref_hz_to_scale(FilterbankScale scale, double hz) {
+    switch (scale) {
+        case FILTERBANK_MEL:
+            return 1127.0 * log(1.0 + hz / 700.0);
+        case FILTERBANK_BARK:
+            return 26.81 / (1.0 + 1960.0 / hz) - 0.53;
+        case FILTERBANK_ERB:
+            return 21.4 * log10(4.37 * hz / 1000.0 + 1.0);
+        default:
+            return hz;
+    }
+}
+
+static double ref_scale_to_hz(FilterbankScale scale, double val) {
+    switch (scale) {
+        case FILTERBANK_MEL:
+            return 700.0 * (exp(val / 1127.0) - 1.0);
+        case FILTERBANK_BARK:
+            return 1960.0 / (26.81 / (val + 0.53) - 1.0);
+        case FILTERBANK_ERB:
+            return (pow(10.0, val / 21.4) - 1.0) * 1000.0 / 4.37;
+        default:
+            return val;
+    }
+}
+
+static const char *get_scale_name(FilterbankScale scale) {
+    switch (scale) {
+        case FILTERBANK_MEL:
+            return "mel";
+        case FILTERBANK_BARK:
+            return "Bark";
+        case FILTERBANK_ERB:
+            return "ERB";
+        default:
+            return "none";
+    }
+}
+
+// Dense triangular filterbank, weights[f * num_bins + k] is the weight of bin k in filter f
+class ReferenceFilterbank {
+   public:
+    ReferenceFilterbank(FilterbankScale scale, int num_filters, int num_bins, double first_bin_freq, double bin_width,
+                        double low_freq, double high_freq) {
+        _num_filters = num_filters;
+        _num_bins = num_bins;
+        weights.assign(num_filters * num_bins, 0.0);
+
+        double low_val = ref_hz_to_scale(scale, low_freq);
+        double step = (ref_hz_to_scale(scale, high_freq) - low_val) / (num_filters + 1);
+        for (int f = 0; f < num_filters; f++) {
+            double left = ref_scale_to_hz(scale, low_val + f * step);
+            double center = ref_scale_to_hz(scale, low_val + (f + 1) * step);
+            double right = ref_scale_to_hz(scale, low_val + (f + 2) * step);
+
+            bool covered = false;
+            for (int k = 0; k < num_bins; k++) {
+                double freq = first_bin_freq + k * bin_width;
+                double weight = max(0.0, min((freq - left) / (center - left), (right - freq) / (right - center)));
+                weights[f * num_bins + k] = weight;
+                covered |= (weight > 0);
+            }
+            if (!covered) {
+                int nearest = constrain(int(round((center - first_bin_freq) / bin_width)), 0, num_bins - 1);
+                weights[f * num_bins + nearest] = 1.0;
+            }
+        }
+    }
+
+    void apply(const float *amplitudes, double *out) {
+        const double *w = weights.data();
+        for (int f = 0; f < _num_filters; f++) {
+            double sum = 0;
+            for (int k = 0; k < _num_bins; k++) {
+                sum += amplitudes[k] * w[k];
+            }
+            out[f] = sum;
+            w += _num_bins;
+        }
+    }
+
+    std::vector<double> weights;
+
+   private:
+    int _num_filters;
+    int _num_bins;
+};
+
+// Validates and times one scale at one length, returning true if it is within BENCH_MAX_ERROR of the reference
+static bool run_filterbank(FilterbankScale scale, int num_filters, const float *spectra) {
+    double bin_width = double(I2S_SAMPLE_RATE) / FFT_SAMPLES;
+    Filterbank fb = Filterbank(scale, num_filters, BENCH_NUM_BINS, bin_width, bin_width, LOWEST_FREQ_BAND,
+                               HIGHEST_FREQ_BAND);
+    ReferenceFilterbank ref = ReferenceFilterbank(scale, num_filters, BENCH_NUM_BINS, bin_width, bin_width,
+                                                  LOWEST_FREQ_BAND, HIGHEST_FREQ_BAND);
+
+    std::vector<float> out(num_filters);
+    std::vector<double> ref_out(num_filters);
+
+    // Weights, one column of the reference matrix at a time
+    static float impulse[BENCH_NUM_BINS];
+    double max_weight_error = 0;
+    std::vector<double> filter_weight(num_filters, 0.0);
+    for (int k = 0; k < BENCH_NUM_BINS; k++) {
+        impulse[k] = 1.0;
+        fb.apply(impulse, out.data());
+        impulse[k] = 0.0;
+        for (int f = 0; f < num_filters; f++) {
+            max_weight_error = max(max_weight_error, fabs(out[f] - ref.weights[f * BENCH_NUM_BINS + k]));
+            filter_weight[f] += out[f];
+        }
+    }
+    int empty_filters = 0;
+    for (int f = 0; f < num_filters; f++) {
+        empty_filters += (filter_weight[f] <= 0);
+    }
+
+    // Outputs and timing on random spectra
+    double max_output_error = 0, max_ref_output = 0;
+    double best_us[2] = {0};
+    float volatile sink = 0;  // keeps the compiler from dropping the loops
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double pass_us[2] = {0};
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            const float *amplitudes = &spectra[frame * BENCH_NUM_BINS];
+
+            bench_clock::time_point t0 = bench_clock::now();
+            fb.apply(amplitudes, out.data());
+            bench_clock::time_point t1 = bench_clock::now();
+            ref.apply(amplitudes, ref_out.data());
+            bench_clock::time_point t2 = bench_clock::now();
+
+            pass_us[0] += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            pass_us[1] += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            sink = sink + out[num_filters - 1] + ref_out[num_filters - 1];
+
+            if (pass == 0) {
+                for (int f = 0; f < num_filters; f++) {
+                    max_output_error = max(max_output_error, fabs(out[f] - ref_out[f]));
+                    max_ref_output = max(max_ref_output, fabs(ref_out[f]));
+                }
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pass == 0 || pass_us[i] < best_us[i]) {
+                best_us[i] = pass_us[i];
+            }
+        }
+    }
+    max_output_error /= max_ref_output;
+
+    bool passed = (max_weight_error <= BENCH_MAX_ERROR) && (max_output_error <= BENCH_MAX_ERROR) && (empty_filters == 0);
+    print("%-4s %3d filters: weight error: %.1e, output error: %.1e, empty filters: %d, apply: %.2f us/frame, "
+          "reference: %.2f us/frame%s\n",
+          get_scale_name(scale), num_filters, max_weight_error, max_output_error, empty_filters,
+          best_us[0] / BENCH_FRAMES, best_us[1] / BENCH_FRAMES, passed ? "" : "  FAIL");
+    return passed;
+}
+
+int main() {
+    print("Filterbanks: FFT_SAMPLES %d, %d bins from %d to %d Hz, %d frames\n", FFT_SAMPLES, BENCH_NUM_BINS,
+          LOWEST_FREQ_BAND, HIGHEST_FREQ_BAND, BENCH_FRAMES);
+
+    static float spectra[BENCH_FRAMES * BENCH_NUM_BINS];
+    srand(1);
+    for (int i = 0; i < BENCH_FRAMES * BENCH_NUM_BINS; i++) {
+        spectra[i] = float(rand()) / RAND_MAX;
+    }
+
+    bool passed = true;
+    for (int scale = FILTERBANK_MEL; scale < FILTERBANK_MAX; scale++) {
+        for (int num_filters : BENCH_LENGTHS) {
+            passed &= run_filterbank(FilterbankScale(scale), num_filters, spectra);
+        }
+    }
+
+    if (!passed) {
+        print("FAIL: a filterbank does not match the reference\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// Compares calc_intensity() with its original floating point version on the host, see [env:native_intensity] in
+// platformio.ini. For NUM_LEDS / 2 LEDs (as run_audio() asks for) and NUM_LEDS LEDs:
+//      curve: every FFT magnitude in steps of 1 / BENCH_SWEEP_STEPS, looked up in the intensity table as in
+//          calc_intensity(), against round(pow(x, FFT_SCALE_POWER) * BRIGHT_LEVELS). Values that are negative,
+//          over 1.0 or NaN are included. The program exits with an error if any level is off by more than one
+//      frames: the same random frames through both versions, each keeping its own intensities from frame to frame,
+//          with the mean and largest difference in brightness levels (a level one off either side of
+//          MIN_BRIGHT_UPDATE decides whether an LED updates at all, so single LEDs can differ by much more than the mean)
+//      timing: the time per frame of each version, including the resampling to the number of LEDs, from the fastest
+//          of BENCH_PASSES
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <vector>
+
+#include "AudioSource.h"
+#include "BeatDetector.h"
+#include "Constants.h"
+#include "FFTWindow.h"
+#include "Filterbank.h"
+#include "FixedFFT.h"
+#include "Resampler.h"
+#include "Utils.h"
+#include "fft.h"
+
+// The AudioProcessor, with its private members opened up so the FFT bins, volume and intensity table can be set and
+// read directly. src/AudioProcessor.cpp is left out of this environment's build.
+#define private public
+#include "AudioProcessor.cpp"
+#undef private
+
+#define BENCH_SWEEP_STEPS 1000000  // FFT magnitudes checked between 0 and 1
+#define BENCH_FRAMES 2000          // random frames per pass
+#define BENCH_PASSES 5             // passes over the frames, the fastest pass is reported to reduce noise from the host
+
+static const int BENCH_LENGTHS[] = {NUM_LEDS / 2, NUM_LEDS};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// The LED loop of the original calc_intensity(), run on the resampled FFT in fft_interp and keeping its intensities
+// in intensity
+static void calc_intensity_before(const float *fft_interp, double avg_volume, int length, int *intensity) {
+    for (int i = 0; i < length; i++) {
+        double val = fft_interp[i];
+        if (val < 0) {
+            val = 0;
+        }
+        double constrain_val = constrain(val, 0, 1);
+        double pow_val = pow(constrain_val, FFT_SCALE_POWER);
+        int map_val = int(round(pow_val * BRIGHT_LEVELS));
+
+        int last_intensity = intensity[i];
+        intensity[i] -= FADE;
+        if (intensity[i] < 0) intensity[i] = 0;
+
+        if ((map_val >= intensity[i]) && (20 * log10(avg_volume) > VOL_THRESH_DB) && (map_val >= MIN_BRIGHT_UPDATE)) {
+            intensity[i] = map_val;
+            intensity[i] = last_intensity * (1 - LED_SMOOTHING) + intensity[i] * (LED_SMOOTHING);
+        }
+        if (intensity[i] < MIN_BRIGHT_FADE) {
+            intensity[i] = 0;
+        }
+    }
+}
+
+// Looks up an FFT magnitude in the intensity table, as calc_intensity() does
+static int lookup_intensity(AudioProcessor &ap, float val) {
+    int index = (val > 0) ? int(min(val, 1.0f) * (INTENSITY_LUT_SIZE - 1) + 0.5f) : 0;
+    return ap._intensity_lut[index];
+}
+
+// Checks the intensity table against the curve it replaces, returning the largest difference in brightness levels
+static int check_curve(AudioProcessor &ap) {
+    int max_diff = 0;
+    for (int step = -10; step <= BENCH_SWEEP_STEPS + 10; step++) {
+        float val = float(step) / BENCH_SWEEP_STEPS;
+        int exact = int(round(pow(constrain(double(val), 0.0, 1.0), FFT_SCALE_POWER) * BRIGHT_LEVELS));
+        max_diff = max(max_diff, abs(lookup_intensity(ap, val) - exact));
+    }
+    max_diff = max(max_diff, lookup_intensity(ap, NAN));  // NaN should be dark
+    return max_diff;
+}
+
+// Runs one number of LEDs, returning true if the intensity table is within one level of the original curve
+static bool run_length(int length, const float *frames) {
+    ToneAudioSource tone = ToneAudioSource(AUDIO_TONE_FREQ, 0.5);
+    AudioProcessor ap = AudioProcessor(false, false, false, false, &tone);
+    int curve_diff = check_curve(ap);
+
+    std::vector<int> before(length, 0);
+    uint64_t sum_diff = 0;
+    int max_diff = 0;
+    double best_us[2] = {0};
+    int volatile sink = 0;  // keeps the compiler from dropping the loops
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double pass_us[2] = {0};
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            memcpy(ap._fft_bin, &frames[frame * (FFT_SAMPLES / 2)], sizeof(float) * (FFT_SAMPLES / 2));
+            ap._avg_volume = 1.0;  // loud enough to update
+
+            bench_clock::time_point t0 = bench_clock::now();
+            ap._interpolate_fft(FFT_SAMPLES / 2, length);
+            calc_intensity_before(ap._fft_interp, ap._avg_volume, length, before.data());
+            bench_clock::time_point t1 = bench_clock::now();
+            ap.calc_intensity(length);
+            bench_clock::time_point t2 = bench_clock::now();
+
+            pass_us[0] += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            pass_us[1] += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            sink = sink + before[length - 1] + ap._intensity[length - 1];
+
+            if (pass == 0) {
+                for (int i = 0; i < length; i++) {
+                    int diff = abs(ap._intensity[i] - before[i]);
+                    sum_diff += diff;
+                    max_diff = max(max_diff, diff);
+                }
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pass == 0 || pass_us[i] < best_us[i]) {
+                best_us[i] = pass_us[i];
+            }
+        }
+    }
+
+    bool passed = (curve_diff <= 1);
+    print("%3d LEDs: curve diff: %d, intensity diff mean: %.3f max: %d, before: %.2f us/frame, after: %.2f us/frame%s\n",
+          length, curve_diff, double(sum_diff) / (BENCH_FRAMES * length), max_diff, best_us[0] / BENCH_FRAMES,
+          best_us[1] / BENCH_FRAMES, passed ? "" : "  FAIL");
+    return passed;
+}
+
+int main() {
+    print("LED intensity: %d entry table, FFT_SCALE_POWER %.2f, %d frames\n", INTENSITY_LUT_SIZE, FFT_SCALE_POWER,
+          BENCH_FRAMES);
+
+    // Each bin wanders randomly so that LEDs rise, hold and fade, and sometimes goes out of range
+    static float frames[BENCH_FRAMES * (FFT_SAMPLES / 2)];
+    srand(1);
+    for (int k = 0; k < FFT_SAMPLES / 2; k++) {
+        float val = 0;
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            val = val * 0.8 + (float(rand()) / RAND_MAX - 0.3) * 0.5;
+            frames[frame * (FFT_SAMPLES / 2) + k] = val;
+        }
+    }
+
+    bool passed = true;
+    for (int length : BENCH_LENGTHS) {
+        passed &= run_length(length, frames);
+    }
+
+    if (!passed) {
+        print("FAIL: the intensity table is off by more than one level\n");
+    }
+    return passed ? 0 : 1;
+}
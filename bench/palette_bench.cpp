@@ -0,0 +1,532 @@
+// Compares the album art palette with the original sort-based mean cut on the host, see [env:native_palette] in
+// platformio.ini. A corpus of synthetic 64x64 album art is run both sampled every BENCH_ART_STEP pixels, as ArtSampler
+// does for the 16x16 palette art, and at full resolution (4096 pixels), through:
+//      mean cut: mean_cut() from MeanCut.cpp
+//      original: the mean cut this replaced, which sorted each bucket by its longest channel (with ArduinoSort's
+//          insertion sort), split it at the pixel closest to the mean, and called itself on copies of each half.
+//          Its sorts are O(n^2), so at full resolution it is only run on the first BENCH_FULL_SEEDS images of each kind
+//      Oklab: oklab_palette() from OklabPalette.cpp, mean cut refined with k-means in Oklab, which is what the
+//          palette uses unless PALETTE_MEAN_CUT_ONLY is defined
+// and the palettes are compared by:
+//      palette ΔE: the mean distance from each color of one palette to the nearest color of the other, as ΔE in
+//          Oklab (Euclidean distance x 100, where 1 is about the smallest visible difference). A palette counts as
+//          changed if any color or the order of the colors changed
+//      pixel ΔE: the mean distance from each pixel above LUMA_THRESH to its nearest palette color, i.e. how well the
+//          palette represents the art
+//      timing: the time per palette, from the fastest of BENCH_PASSES
+// The program exits with an error if mean cut and the original give different palettes for any image, or if Oklab
+// represents the art worse than the mean cut it starts from. The palettes from the full art are also compared with
+// those from the sampled art, measured against the full art, and the original is run with the other rule for picking
+// the longest channel (see get_longest_dim()), to show what choosing between them changes.
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Constants.h"
+#include "MeanCut.h"
+#include "OklabPalette.h"
+#include "Utils.h"
+
+#define BENCH_ART_SIZE 64  // width and height of the synthetic art
+#define BENCH_ART_STEP 4   // the palette is calculated from every Nth row/col of the art, as for the 16x16 palette
+#define BENCH_SEEDS 8      // images of each kind
+#define BENCH_FULL_SEEDS 1  // images of each kind the original is run on at full resolution
+#define BENCH_PASSES 5     // passes over the corpus, the fastest pass is reported to reduce noise from the host
+
+enum ArtKind {
+    ART_BLOCKS,    // flat colored rectangles, like a poster
+    ART_GRADIENT,  // a two color gradient with a spot of a third
+    ART_BLOBS,     // soft colored blobs on a dark background
+    ART_TEXTURE,   // smoothly varying color with noise, like a photo
+    ART_MUTED,     // nearly gray with a small saturated accent
+    ART_KIND_MAX,
+};
+
+static const char *ART_KIND_NAMES[ART_KIND_MAX] = {"blocks", "gradient", "blobs", "texture", "muted"};
+
+// Rules for picking the longest channel of a bucket, see get_longest_dim()
+enum LongestDimRule {
+    LONGEST_DIM_RED_OVER_GREEN,  // red whenever its range is at least green's, even if blue's is larger
+    LONGEST_DIM_LARGEST,         // the largest range, preferring red, then green, on ties
+};
+
+static const char *LONGEST_DIM_RULE_NAMES[] = {"red over green", "largest"};
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct oklab {
+    double L;
+    double a;
+    double b;
+} oklab_t;
+
+static uint16_t to_rgb565(double r, double g, double b) {
+    uint16_t r5 = uint16_t(round(constrain(r, 0.0, 1.0) * 31));
+    uint16_t g6 = uint16_t(round(constrain(g, 0.0, 1.0) * 63));
+    uint16_t b5 = uint16_t(round(constrain(b, 0.0, 1.0) * 31));
+    return (r5 << 11) | (g6 << 5) | b5;
+}
+
+static double rand_unit() {
+    return double(rand()) / RAND_MAX;
+}
+
+// Generates one image of the corpus, in row major order
+static void make_art(ArtKind kind, int seed, uint16_t *art) {
+    srand(1000 * kind + seed + 1);
+    double c[4][3];  // random colors for the image to use
+    for (int i = 0; i < 4; i++) {
+        for (int ch = 0; ch < 3; ch++) {
+            c[i][ch] = rand_unit();
+        }
+    }
+
+    switch (kind) {
+        case ART_BLOCKS: {
+            for (int i = 0; i < BENCH_ART_SIZE * BENCH_ART_SIZE; i++) {
+                art[i] = to_rgb565(c[0][0], c[0][1], c[0][2]);
+            }
+            int num_blocks = 6 + rand() % 7;
+            for (int n = 0; n < num_blocks; n++) {
+                int x0 = rand() % BENCH_ART_SIZE, y0 = rand() % BENCH_ART_SIZE;
+                int w = 4 + rand() % 32, h = 4 + rand() % 32;
+                uint16_t color = to_rgb565(rand_unit(), rand_unit(), rand_unit());
+                for (int y = y0; y < min(y0 + h, BENCH_ART_SIZE); y++) {
+                    for (int x = x0; x < min(x0 + w, BENCH_ART_SIZE); x++) {
+                        art[y * BENCH_ART_SIZE + x] = color;
+                    }
+                }
+            }
+            break;
+        }
+        case ART_GRADIENT: {
+            double spot_x = rand_unit(), spot_y = rand_unit();
+            for (int y = 0; y < BENCH_ART_SIZE; y++) {
+                for (int x = 0; x < BENCH_ART_SIZE; x++) {
+                    double t = double(x + y) / (2 * (BENCH_ART_SIZE - 1));
+                    double dx = double(x) / BENCH_ART_SIZE - spot_x, dy = double(y) / BENCH_ART_SIZE - spot_y;
+                    double spot = exp(-(dx * dx + dy * dy) / 0.02);
+                    double rgb[3];
+                    for (int ch = 0; ch < 3; ch++) {
+                        rgb[ch] = ((1 - t) * c[0][ch] + t * c[1][ch]) * (1 - spot) + c[2][ch] * spot;
+                    }
+                    art[y * BENCH_ART_SIZE + x] = to_rgb565(rgb[0], rgb[1], rgb[2]);
+                }
+            }
+            break;
+        }
+        case ART_BLOBS: {
+            double blob_x[4], blob_y[4], blob_r[4];
+            for (int n = 0; n < 4; n++) {
+                blob_x[n] = rand_unit();
+                blob_y[n] = rand_unit();
+                blob_r[n] = 0.01 + 0.04 * rand_unit();
+            }
+            for (int y = 0; y < BENCH_ART_SIZE; y++) {
+                for (int x = 0; x < BENCH_ART_SIZE; x++) {
+                    double rgb[3] = {0.05, 0.05, 0.08};
+                    for (int n = 0; n < 4; n++) {
+                        double dx = double(x) / BENCH_ART_SIZE - blob_x[n], dy = double(y) / BENCH_ART_SIZE - blob_y[n];
+                        double weight = exp(-(dx * dx + dy * dy) / blob_r[n]);
+                        for (int ch = 0; ch < 3; ch++) {
+                            rgb[ch] += c[n][ch] * weight;
+                        }
+                    }
+                    art[y * BENCH_ART_SIZE + x] = to_rgb565(rgb[0], rgb[1], rgb[2]);
+                }
+            }
+            break;
+        }
+        case ART_TEXTURE: {
+            double freq[3][2], phase[3];
+            for (int ch = 0; ch < 3; ch++) {
+                freq[ch][0] = 1 + 4 * rand_unit();
+                freq[ch][1] = 1 + 4 * rand_unit();
+                phase[ch] = 2 * PI * rand_unit();
+            }
+            for (int y = 0; y < BENCH_ART_SIZE; y++) {
+                for (int x = 0; x < BENCH_ART_SIZE; x++) {
+                    double rgb[3];
+                    for (int ch = 0; ch < 3; ch++) {
+                        double wave = sin(2 * PI * (freq[ch][0] * x + freq[ch][1] * y) / BENCH_ART_SIZE + phase[ch]);
+                        rgb[ch] = c[0][ch] + 0.35 * wave + 0.1 * (rand_unit() - 0.5);
+                    }
+                    art[y * BENCH_ART_SIZE + x] = to_rgb565(rgb[0], rgb[1], rgb[2]);
+                }
+            }
+            break;
+        }
+        default: {  // ART_MUTED
+            double gray = 0.3 + 0.4 * rand_unit();
+            int x0 = rand() % (BENCH_ART_SIZE - 12), y0 = rand() % (BENCH_ART_SIZE - 12);
+            for (int y = 0; y < BENCH_ART_SIZE; y++) {
+                for (int x = 0; x < BENCH_ART_SIZE; x++) {
+                    double rgb[3];
+                    bool accent = (x >= x0 && x < x0 + 12 && y >= y0 && y < y0 + 12);
+                    for (int ch = 0; ch < 3; ch++) {
+                        rgb[ch] = accent ? c[1][ch] : gray + 0.1 * (c[0][ch] - 0.5) + 0.05 * (rand_unit() - 0.5);
+                    }
+                    art[y * BENCH_ART_SIZE + x] = to_rgb565(rgb[0], rgb[1], rgb[2]);
+                }
+            }
+            break;
+        }
+    }
+}
+
+// Samples every step-th row and column of the art, taking the first pixel of each cell as ArtSampler does
+static std::vector<uint16_t> sample_art(const uint16_t *art, int step) {
+    std::vector<uint16_t> pixels;
+    for (int y = 0; y < BENCH_ART_SIZE; y += step) {
+        for (int x = 0; x < BENCH_ART_SIZE; x += step) {
+            pixels.push_back(art[y * BENCH_ART_SIZE + x]);
+        }
+    }
+    return pixels;
+}
+
+// The original mean cut, with the longest channel picked by the given rule. Helpers that are unchanged in MeanCut.cpp
+// (rgb565_to_rgb888(), rgb888_to_luma() and rgb888_to_hue()) are shared.
+namespace original {
+
+// ArduinoSort's sortArray(), an insertion sort that moves an element down while largerThan(previous, element)
+template <typename T>
+static void sort_array(T *array, uint32_t length, bool (*larger_than)(T, T)) {
+    for (uint32_t i = 1; i < length; i++) {
+        for (uint32_t j = i; j > 0 && larger_than(array[j - 1], array[j]); j--) {
+            T tmp = array[j - 1];
+            array[j - 1] = array[j];
+            array[j] = tmp;
+        }
+    }
+}
+
+static LongestDimRule longest_dim_rule;
+
+static int get_longest_dim(uint16_t *rgb565_arr, uint32_t length) {
+    uint8_t rgb888_arr[3];
+    uint8_t rgb_max_arr[3] = {0, 0, 0};
+    uint8_t rgb_min_arr[3] = {255, 255, 255};
+    uint8_t rgb_ranges[3];
+
+    for (uint32_t i = 0; i < length; i++) {
+        rgb565_to_rgb888(rgb565_arr[i], rgb888_arr);
+        for (int c = 0; c < 3; c++) {
+            rgb_max_arr[c] = max(rgb_max_arr[c], rgb888_arr[c]);
+            rgb_min_arr[c] = min(rgb_min_arr[c], rgb888_arr[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        rgb_ranges[c] = rgb_max_arr[c] - rgb_min_arr[c];
+    }
+
+    int other = (longest_dim_rule == LONGEST_DIM_RED_OVER_GREEN) ? 1 : 2;  // what red is compared with the second time
+    if ((rgb_ranges[0] >= rgb_ranges[1]) && (rgb_ranges[0] >= rgb_ranges[other])) {
+        return 0;
+    }
+    if ((rgb_ranges[1] >= rgb_ranges[0]) && (rgb_ranges[1] >= rgb_ranges[2])) {
+        return 1;
+    }
+    return 2;
+}
+
+static int sort_channel;  // channel compared by channel_is_larger()
+
+static bool channel_is_larger(uint16_t first, uint16_t second) {
+    uint8_t rgb888_first_arr[3];
+    uint8_t rgb888_second_arr[3];
+    rgb565_to_rgb888(first, rgb888_first_arr);
+    rgb565_to_rgb888(second, rgb888_second_arr);
+    return rgb888_first_arr[sort_channel] > rgb888_second_arr[sort_channel];
+}
+
+static bool hue_is_larger(rgb888_t first, rgb888_t second) {
+    return rgb888_to_hue(first) > rgb888_to_hue(second);
+}
+
+static bool luma_is_smaller(uint16_t first, uint16_t second) {
+    uint8_t rgb888_first_arr[3];
+    uint8_t rgb888_second_arr[3];
+    rgb565_to_rgb888(first, rgb888_first_arr);
+    rgb565_to_rgb888(second, rgb888_second_arr);
+    return rgb888_to_luma(rgb888_first_arr) < rgb888_to_luma(rgb888_second_arr);
+}
+
+static uint32_t length_above_luma_thresh(uint16_t *rgb565_arr, uint32_t length, uint8_t threshold) {
+    sort_array(rgb565_arr, length, luma_is_smaller);  // sort by descending luma
+    uint32_t idx;
+    uint8_t rgb888_arr[3];
+    for (idx = 0; idx < length; idx++) {
+        rgb565_to_rgb888(rgb565_arr[idx], rgb888_arr);
+        if (rgb888_to_luma(rgb888_arr) < threshold) break;
+    }
+    return idx;
+}
+
+static void get_mean_color(uint16_t *rgb565_arr, uint32_t length, uint8_t *mean_rgb888_arr) {
+    if (length == 0) {
+        return;
+    }
+    uint32_t sum_rgb888_arr[3] = {0, 0, 0};
+    uint8_t curr_rgb888_arr[3];
+    for (uint32_t i = 0; i < length; i++) {
+        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
+        for (int c = 0; c < 3; c++) {
+            sum_rgb888_arr[c] += curr_rgb888_arr[c];
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        mean_rgb888_arr[c] = int(round(float(sum_rgb888_arr[c]) / length));
+    }
+}
+
+static uint32_t get_mean_idx(uint16_t *rgb565_arr, uint32_t length, uint8_t channel) {
+    if (length == 0) {
+        return 0;
+    }
+    uint32_t sum = 0;
+    uint8_t curr_rgb888_arr[3];
+    for (uint32_t i = 0; i < length; i++) {
+        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
+        sum += curr_rgb888_arr[channel];
+    }
+    float mean_val = float(sum) / length;
+
+    float min_diff = 255;
+    uint32_t idx = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
+        float curr_diff = fabs(curr_rgb888_arr[channel] - mean_val);
+        if (curr_diff < min_diff) {
+            min_diff = curr_diff;
+            idx = i;
+        }
+    }
+    return idx;
+}
+
+static void mean_cut(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results);
+
+static void mean_cut_recursive(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
+    if ((depth == 0) || (length == 0)) {
+        get_mean_color(rgb565_arr, length, results);
+        return;
+    }
+
+    sort_channel = get_longest_dim(rgb565_arr, length);
+    sort_array(rgb565_arr, length, channel_is_larger);
+    uint32_t length0 = get_mean_idx(rgb565_arr, length, sort_channel);
+
+    std::vector<uint16_t> rgb565_arr_0(rgb565_arr, rgb565_arr + length0);
+    std::vector<uint16_t> rgb565_arr_1(rgb565_arr + length0, rgb565_arr + length);
+    mean_cut(rgb565_arr_0.data(), length0, depth - 1, results);
+    mean_cut(rgb565_arr_1.data(), length - length0, depth - 1, results + (1 << (depth - 1)) * 3);
+}
+
+static void mean_cut(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
+    uint32_t new_length = length_above_luma_thresh(rgb565_arr, length, LUMA_THRESH);
+    mean_cut_recursive(rgb565_arr, new_length, depth, results);
+    sort_array((rgb888_t *)results, 1 << depth, hue_is_larger);
+}
+
+}  // namespace original
+
+// Oklab from gamma encoded RGB888, decoded with JPG_GAMMA as in OklabPalette.cpp, in double precision
+static oklab_t rgb888_to_oklab(const uint8_t *rgb888_arr) {
+    double lin[3];
+    for (int c = 0; c < 3; c++) {
+        lin[c] = pow(rgb888_arr[c] / 255.0, JPG_GAMMA);
+    }
+    double l = cbrt(0.4122214708 * lin[0] + 0.5363325363 * lin[1] + 0.0514459929 * lin[2]);
+    double m = cbrt(0.2119034982 * lin[0] + 0.6806995451 * lin[1] + 0.1073969566 * lin[2]);
+    double s = cbrt(0.0883024619 * lin[0] + 0.2817188376 * lin[1] + 0.6299787005 * lin[2]);
+    return {0.2104542553 * l + 0.7936177850 * m - 0.0040720468 * s,
+            1.9779984951 * l - 2.4285922050 * m + 0.4505937099 * s,
+            0.0259040371 * l + 0.7827717662 * m - 0.8086757660 * s};
+}
+
+static double delta_e(const oklab_t &x, const oklab_t &y) {
+    return 100 * sqrt((x.L - y.L) * (x.L - y.L) + (x.a - y.a) * (x.a - y.a) + (x.b - y.b) * (x.b - y.b));
+}
+
+// The mean distance from each color of one palette to the nearest color of the other, taken both ways so that colors
+// that only moved within the hue order do not count
+static double calc_palette_delta_e(const uint8_t *palette1, const uint8_t *palette2) {
+    oklab_t lab[2][PALETTE_ENTRIES];
+    for (int k = 0; k < PALETTE_ENTRIES; k++) {
+        lab[0][k] = rgb888_to_oklab(&palette1[k * 3]);
+        lab[1][k] = rgb888_to_oklab(&palette2[k * 3]);
+    }
+
+    double sum = 0;
+    for (int p = 0; p < 2; p++) {
+        for (int k = 0; k < PALETTE_ENTRIES; k++) {
+            double nearest = INFINITY;
+            for (int n = 0; n < PALETTE_ENTRIES; n++) {
+                nearest = min(nearest, delta_e(lab[p][k], lab[1 - p][n]));
+            }
+            sum += nearest;
+        }
+    }
+    return sum / (2 * PALETTE_ENTRIES);
+}
+
+// The mean distance from each pixel at or above LUMA_THRESH to its nearest palette color
+static double calc_pixel_delta_e(const std::vector<uint16_t> &pixels, const uint8_t *palette) {
+    oklab_t palette_lab[PALETTE_ENTRIES];
+    for (int k = 0; k < PALETTE_ENTRIES; k++) {
+        palette_lab[k] = rgb888_to_oklab(&palette[k * 3]);
+    }
+
+    double sum = 0;
+    int count = 0;
+    for (uint16_t pixel : pixels) {
+        uint8_t rgb888_arr[3];
+        rgb565_to_rgb888(pixel, rgb888_arr);
+        if (rgb888_to_luma(rgb888_arr) < LUMA_THRESH) {
+            continue;
+        }
+        oklab_t lab = rgb888_to_oklab(rgb888_arr);
+        double nearest = INFINITY;
+        for (int k = 0; k < PALETTE_ENTRIES; k++) {
+            nearest = min(nearest, delta_e(lab, palette_lab[k]));
+        }
+        sum += nearest;
+        count++;
+    }
+    return (count > 0) ? sum / count : 0;
+}
+
+typedef void (*palette_fn)(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results);
+
+// Calculates the palette of every image with fn, keeping the fastest of passes passes. Returns the time per palette
+// in microseconds.
+static double run_palettes(palette_fn fn, const std::vector<std::vector<uint16_t>> &corpus, int passes,
+                           std::vector<std::vector<uint8_t>> &palettes) {
+    palettes.assign(corpus.size(), std::vector<uint8_t>(PALETTE_ENTRIES * 3, 0));
+    double best_us = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        double pass_us = 0;
+        for (size_t i = 0; i < corpus.size(); i++) {
+            std::vector<uint16_t> pixels = corpus[i];  // the palette functions reorder the pixels
+            std::fill(palettes[i].begin(), palettes[i].end(), 0);
+
+            bench_clock::time_point t0 = bench_clock::now();
+            fn(pixels.data(), pixels.size(), MEAN_CUT_DEPTH, palettes[i].data());
+            bench_clock::time_point t1 = bench_clock::now();
+            pass_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+        }
+        if (pass == 0 || pass_us < best_us) {
+            best_us = pass_us;
+        }
+    }
+    return best_us / corpus.size();
+}
+
+static void run_original(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
+    original::mean_cut(rgb565_arr, length, depth, results);
+}
+
+// Compares two sets of palettes, printing how many differ, by how much, and how well each represents the art.
+// Returns the number of palettes that differ, and the mean pixel ΔE of each set in pixel_de if it is given.
+static int compare_palettes(const char *name1, const std::vector<std::vector<uint8_t>> &palettes1, const char *name2,
+                            const std::vector<std::vector<uint8_t>> &palettes2,
+                            const std::vector<std::vector<uint16_t>> &corpus, double *pixel_de = NULL) {
+    int changed = 0;
+    double sum_palette_de = 0, max_palette_de = 0, sum_pixel_de[2] = {0};
+    for (size_t i = 0; i < corpus.size(); i++) {
+        double palette_de = calc_palette_delta_e(palettes1[i].data(), palettes2[i].data());
+        changed += (palettes1[i] != palettes2[i]);
+        sum_palette_de += palette_de;
+        max_palette_de = max(max_palette_de, palette_de);
+        sum_pixel_de[0] += calc_pixel_delta_e(corpus[i], palettes1[i].data());
+        sum_pixel_de[1] += calc_pixel_delta_e(corpus[i], palettes2[i].data());
+    }
+    print("%s vs %s: %d of %d palettes changed, palette ΔE mean: %.2f max: %.2f, pixel ΔE %s: %.2f, %s: %.2f\n",
+          name1, name2, changed, int(corpus.size()), sum_palette_de / corpus.size(), max_palette_de, name1,
+          sum_pixel_de[0] / corpus.size(), name2, sum_pixel_de[1] / corpus.size());
+    if (pixel_de != NULL) {
+        pixel_de[0] = sum_pixel_de[0] / corpus.size();
+        pixel_de[1] = sum_pixel_de[1] / corpus.size();
+    }
+    return changed;
+}
+
+int main() {
+    // The corpus sampled as for the palette art, at full resolution, and at full resolution for the original
+    std::vector<std::vector<uint16_t>> sampled_corpus, full_corpus, full_original_corpus;
+    static uint16_t art[BENCH_ART_SIZE * BENCH_ART_SIZE];
+    for (int kind = 0; kind < ART_KIND_MAX; kind++) {
+        for (int seed = 0; seed < BENCH_SEEDS; seed++) {
+            make_art(ArtKind(kind), seed, art);
+            sampled_corpus.push_back(sample_art(art, BENCH_ART_STEP));
+            full_corpus.push_back(sample_art(art, 1));
+            if (seed < BENCH_FULL_SEEDS) {
+                full_original_corpus.push_back(full_corpus.back());
+            }
+        }
+    }
+
+    // The rule MeanCut.cpp uses, from a bucket where blue has the largest range but red's is larger than green's
+    const uint8_t probe_ranges[3] = {100, 50, 200};
+    LongestDimRule tree_rule = (get_longest_dim(probe_ranges) == 0) ? LONGEST_DIM_RED_OVER_GREEN : LONGEST_DIM_LARGEST;
+    LongestDimRule other_rule = (tree_rule == LONGEST_DIM_LARGEST) ? LONGEST_DIM_RED_OVER_GREEN : LONGEST_DIM_LARGEST;
+
+    print("Palettes: %d images (", int(sampled_corpus.size()));
+    for (int kind = 0; kind < ART_KIND_MAX; kind++) {
+        print("%s%s", ART_KIND_NAMES[kind], (kind < ART_KIND_MAX - 1) ? ", " : "");
+    }
+    print("), %dx%d art, %d colors, longest channel: %s\n", BENCH_ART_SIZE, BENCH_ART_SIZE, PALETTE_ENTRIES,
+          LONGEST_DIM_RULE_NAMES[tree_rule]);
+    original::longest_dim_rule = tree_rule;
+    int changed = 0;
+
+    // Sampled art
+    std::vector<std::vector<uint8_t>> sampled_palettes, original_palettes, other_rule_palettes;
+    double sampled_us = run_palettes(mean_cut, sampled_corpus, BENCH_PASSES, sampled_palettes);
+    double original_us = run_palettes(run_original, sampled_corpus, BENCH_PASSES, original_palettes);
+    print("Sampled every %d pixels (%d pixels):\n", BENCH_ART_STEP, int(sampled_corpus[0].size()));
+    changed += compare_palettes("mean cut", sampled_palettes, "original", original_palettes, sampled_corpus);
+    print("mean cut: %.1f us/palette, original: %.1f us/palette\n", sampled_us, original_us);
+
+    // Full art, with the original on only part of the corpus as its sorts are slow
+    std::vector<std::vector<uint8_t>> full_palettes, full_subset_palettes, full_original_palettes;
+    double full_us = run_palettes(mean_cut, full_corpus, BENCH_PASSES, full_palettes);
+    double full_subset_us = run_palettes(mean_cut, full_original_corpus, BENCH_PASSES, full_subset_palettes);
+    double full_original_us = run_palettes(run_original, full_original_corpus, 1, full_original_palettes);
+    print("Full resolution (%d pixels):\n", int(full_corpus[0].size()));
+    changed += compare_palettes("mean cut", full_subset_palettes, "original", full_original_palettes,
+                                full_original_corpus);
+    print("mean cut: %.1f us/palette (%.1f us/palette on all %d images), original: %.1f us/palette\n",
+          full_subset_us, full_us, int(full_corpus.size()), full_original_us);
+    compare_palettes("full", full_palettes, "sampled", sampled_palettes, full_corpus);
+
+    // Oklab on the full art, as the palette is calculated
+    std::vector<std::vector<uint8_t>> oklab_palettes;
+    double oklab_us = run_palettes(oklab_palette, full_corpus, BENCH_PASSES, oklab_palettes);
+    double pixel_de[2];
+    print("Oklab, full resolution:\n");
+    compare_palettes("Oklab", oklab_palettes, "mean cut", full_palettes, full_corpus, pixel_de);
+    print("Oklab: %.1f us/palette, mean cut: %.1f us/palette\n", oklab_us, full_us);
+    bool oklab_worse = (pixel_de[0] > pixel_de[1]);
+
+    // The other longest channel rule
+    original::longest_dim_rule = other_rule;
+    run_palettes(run_original, sampled_corpus, 1, other_rule_palettes);
+    print("Longest channel rules, sampled every %d pixels:\n", BENCH_ART_STEP);
+    compare_palettes(LONGEST_DIM_RULE_NAMES[tree_rule], original_palettes, LONGEST_DIM_RULE_NAMES[other_rule],
+                     other_rule_palettes, sampled_corpus);
+
+    if (changed > 0) {
+        print("FAIL: mean cut does not match the original on %d palettes\n", changed);
+    }
+    if (oklab_worse) {
+        print("FAIL: Oklab represents the art worse than mean cut\n");
+    }
+    return (changed > 0 || oklab_worse) ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Compares the Resampler with the original _interpolate_fft() on the host, see [env:native_resample] in
+// platformio.ini. Each pair of lengths the AudioProcessor resamples between is run on the same random spectra with:
+//      before: the original _interpolate_fft(), which interpolated up in double precision and, when downsampling,
+//          averaged the interpolated points back down through a temporary buffer on every call
+//      after: Resampler::apply() with the plan built once for the pair of lengths
+// The largest difference between the two is reported relative to full scale, along with the time per frame of each
+// from the fastest of BENCH_PASSES. The program exits with an error if the difference is over BENCH_MAX_ERROR, which
+// allows for the Resampler's Q8 weights.
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Constants.h"
+#include "Resampler.h"
+#include "Utils.h"
+
+#define BENCH_FRAMES 2000  // random spectra per pass
+#define BENCH_PASSES 5     // passes over the spectra, the fastest pass is reported to reduce noise from the host
+#define BENCH_MAX_ERROR (1.0 / (1 << RESAMPLER_Q_BITS))  // each Q8 weight is within half of this of the exact weight
+
+typedef struct resample_case {
+    const char *name;
+    int old_length;
+    int new_length;
+} resample_case_t;
+
+static const resample_case_t BENCH_CASES[] = {
+    {"FFT to LEDs", FFT_SAMPLES / 2, NUM_LEDS / 2},  // calc_intensity()
+    {"FFT to columns", FFT_SAMPLES / 2, GRID_W},
+    {"bands to columns", NUM_AUDIO_BANDS, GRID_W},  // calc_intensity_simple()
+    {"bands to LEDs", NUM_AUDIO_BANDS, NUM_LEDS / 2},
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// The original _interpolate_fft(), reading from in rather than _fft_bin and writing to out rather than _fft_interp.
+// The temporary buffer is static, so allocating it costs nothing, as it did on the stack.
+static void interpolate_before(const float *in, float *out, int old_length, int new_length) {
+    double scaled_index, fractional_index, floor_val, next_val, interp_val;
+    int16_t floor_index;
+    static double fft_upscale[FFT_SAMPLES];  // was a variable-length array on the stack, this holds the longest one
+
+    if (new_length > old_length) {
+        for (int i = 0; i < new_length; i++) {
+            scaled_index = (i / double((new_length - 1))) * double(old_length - 1);
+            floor_index = uint16_t(floor(scaled_index));
+            fractional_index = scaled_index - floor_index;
+            floor_val = in[floor_index];
+            if ((floor_index + 1) < old_length) {
+                next_val = in[floor_index + 1];
+            } else {
+                next_val = in[floor_index];
+            }
+
+            interp_val = double(floor_val) + double(next_val - floor_val) * fractional_index;
+            out[i] = interp_val;
+        }
+    } else if (new_length == old_length) {
+        for (int i = 0; i < new_length; i++) {
+            out[i] = in[i];
+        }
+    } else {
+        int multiple = ceil(double(old_length) / double(new_length));
+        int upscale_len = multiple * new_length;
+        for (int i = 0; i < upscale_len; i++) {
+            scaled_index = (i / double((upscale_len - 1))) * double(old_length - 1);
+            floor_index = uint16_t(floor(scaled_index));
+            fractional_index = scaled_index - floor_index;
+            floor_val = in[floor_index];
+            if ((floor_index + 1) < old_length) {
+                next_val = in[floor_index + 1];
+            } else {
+                next_val = in[floor_index];
+            }
+
+            interp_val = double(floor_val) + double(next_val - floor_val) * fractional_index;
+            fft_upscale[i] = interp_val;
+        }
+
+        for (int i = 0; i < new_length; i++) {
+            interp_val = 0;
+            for (int j = 0; j < multiple; j++) {
+                interp_val += double(fft_upscale[i * multiple + j]) / double(multiple);
+            }
+            out[i] = interp_val;
+        }
+    }
+}
+
+// Compares and times one pair of lengths, returning true if the Resampler is within BENCH_MAX_ERROR
+static bool run_case(const resample_case_t &c, const float *spectra, int spectrum_length) {
+    Resampler resampler = Resampler(c.old_length, c.new_length);
+    std::vector<float> before(c.new_length), after(c.new_length);
+
+    double max_error = 0;
+    double best_us[2] = {0};
+    float volatile sink = 0;  // keeps the compiler from dropping the loops
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double pass_us[2] = {0};
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            const float *in = &spectra[frame * spectrum_length];
+
+            bench_clock::time_point t0 = bench_clock::now();
+            interpolate_before(in, before.data(), c.old_length, c.new_length);
+            bench_clock::time_point t1 = bench_clock::now();
+            resampler.apply(in, after.data());
+            bench_clock::time_point t2 = bench_clock::now();
+
+            pass_us[0] += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            pass_us[1] += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            sink = sink + before[c.new_length - 1] + after[c.new_length - 1];
+
+            if (pass == 0) {
+                for (int i = 0; i < c.new_length; i++) {
+                    max_error = max(max_error, double(fabs(after[i] - before[i])));  // spectra are in [0, 1]
+                }
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (pass == 0 || pass_us[i] < best_us[i]) {
+                best_us[i] = pass_us[i];
+            }
+        }
+    }
+
+    bool passed = (max_error <= BENCH_MAX_ERROR);
+    print("%-16s %3d -> %3d: max error: %.1e, before: %.2f us/frame, after: %.2f us/frame%s\n", c.name,
+          c.old_length, c.new_length, max_error, best_us[0] / BENCH_FRAMES, best_us[1] / BENCH_FRAMES,
+          passed ? "" : "  FAIL");
+    return passed;
+}
+
+int main() {
+    print("Resampling: Q%d weights, %d frames\n", RESAMPLER_Q_BITS, BENCH_FRAMES);
+
+    const int spectrum_length = FFT_SAMPLES / 2;  // the longest input
+    static float spectra[BENCH_FRAMES * (FFT_SAMPLES / 2)];
+    srand(1);
+    for (int i = 0; i < BENCH_FRAMES * spectrum_length; i++) {
+        spectra[i] = float(rand()) / RAND_MAX;
+    }
+
+    bool passed = true;
+    for (const resample_case_t &c : BENCH_CASES) {
+        passed &= run_case(c, spectra, spectrum_length);
+    }
+
+    if (!passed) {
+        print("FAIL: the Resampler does not match the original interpolation\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+// Checks the FFT windows on synthetic tones on the host, see [env:native_window] in platformio.ini. For each window
+// type and each FFT path (float and fixed-point), tones are loaded through the AudioProcessor's sample history and
+// _load_fft_input(), where DC removal, windowing and scaling are fused into one pass, and then through the FFT:
+//      input error: the largest difference between the FFT input and a reference computed in double precision from
+//          the window's cosine coefficients, with the DC offset removed, relative to full scale. The samples wrap
+//          around the sample history, so this also checks they are loaded oldest first
+//      DC rejection: the largest change in any bin when a DC offset of BENCH_DC_OFFSET is added to the tone,
+//          relative to the tone
+//      peak error: the error in the tone's amplitude, for a tone centered on a bin and one halfway between two
+//          bins (the scalloping loss)
+//      leakage: the largest bin at least BENCH_LEAKAGE_BINS away from a tone halfway between two bins, and from DC,
+//          relative to the tone
+// Each is checked against the limits for its window in WINDOW_LIMITS, and the program exits with an error if any is
+// exceeded. The fixed-point path approximates magnitudes (see FixedFFT.h), so its amplitudes are allowed
+// BENCH_FIXED_MAGNITUDE_DB of extra error.
+//
+// Usage: program
+
+#include <Arduino.h>
+
+#include "AudioSource.h"
+#include "BeatDetector.h"
+#include "Constants.h"
+#include "FFTWindow.h"
+#include "Filterbank.h"
+#include "FixedFFT.h"
+#include "Resampler.h"
+#include "Utils.h"
+#include "fft.h"
+#include "window_bench.h"
+
+// The float build of the AudioProcessor, with its private members opened up so the FFT input and amplitudes can be
+// read. src/AudioProcessor.cpp is left out of this environment's build.
+#ifdef FFT_FIXED_POINT
+#error "window_bench builds both FFT paths itself, so FFT_FIXED_POINT must not be defined"
+#endif
+#define private public
+#include "AudioProcessor.cpp"
+#undef private
+
+#define BENCH_TONE_BIN 100         // bin of the test tone, far enough from DC that the main lobe stays clear of it
+#define BENCH_TONE_AMPLITUDE 0.5   // relative to full scale
+#define BENCH_DC_OFFSET 0.25       // relative to full scale
+#define BENCH_LEAKAGE_BINS 8       // leakage is measured this many bins or more from the tone, clear of any main lobe
+#define BENCH_FIXED_MAGNITUDE_DB 0.36  // worst-case error of FixedFFT's alpha max plus beta min magnitudes (-4%, +3.9%)
+
+typedef struct window_limits {
+    double coeffs[5];        // generalized cosine coefficients, as in FFTWindow.cpp, for the reference window
+    double max_input_db;     // input error
+    double max_dc_db;        // DC rejection
+    double max_peak_db;      // error of a tone centered on a bin, either way
+    double min_scallop_db;   // lowest amplitude of a tone halfway between two bins
+    double max_leakage_db;   // leakage
+} window_limits_t;
+
+// Indexed by FFTWindowType
+static const window_limits_t WINDOW_LIMITS[FFT_WINDOW_MAX] = {
+    {{1.0, 0.0, 0.0, 0.0, 0.0}, -90, -90, 0.01, -4.0, -25},                                       // rectangular
+    {{0.5, 0.5, 0.0, 0.0, 0.0}, -90, -90, 0.01, -1.5, -62},                                       // Hann
+    {{0.35875, 0.48829, 0.14128, 0.01168, 0.0}, -90, -90, 0.01, -0.9, -88},                       // Blackman-Harris
+    {{0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368}, -90, -90, 0.01, -0.02, -85},  // flat-top
+};
+
+typedef void (*run_window_fn)(FFTWindowType type, const int32_t *samples, double *fft_input, double *amplitudes);
+
+void run_float_window(FFTWindowType type, const int32_t *samples, double *fft_input, double *amplitudes) {
+    static SignalAudioSource source;
+    static AudioProcessor ap = AudioProcessor(false, false, false, false, &source);
+
+    source.set_samples(samples);
+    ap._window = get_fft_window(type);
+    ap.get_audio_samples();
+    ap.get_audio_samples_gapless();
+
+    ap._load_fft_input();
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        fft_input[i] = ap._v_real[i];
+    }
+
+    ap._perform_fft();  // loads the FFT input again
+    for (int i = 0; i < FFT_SAMPLES / 2 - 1; i++) {
+        amplitudes[i] = ap._v_real[i];
+    }
+}
+
+// Generates a tone at a (possibly fractional) bin plus a DC offset, in the I2S mic's format
+static void make_tone(double bin, double dc_offset, int32_t *samples) {
+    double full_scale = 1 << (I2S_MIC_BIT_DEPTH - 1);
+    for (int i = 0; i < WINDOW_BENCH_SAMPLES; i++) {
+        double val = dc_offset + BENCH_TONE_AMPLITUDE * sin(2 * PI * bin * i / FFT_SAMPLES + 0.3);
+        samples[i] = int32_t(round(val * (full_scale - 1))) * (1 << (32 - I2S_MIC_BIT_DEPTH));
+    }
+}
+
+// The largest difference between the FFT input and a reference, relative to full scale
+static double calc_input_error_db(FFTWindowType type, const int32_t *samples, const double *fft_input) {
+    const int32_t *window_samples = &samples[WINDOW_BENCH_SAMPLES - FFT_SAMPLES];  // the FFT covers the last samples
+    double full_scale = 1 << (I2S_MIC_BIT_DEPTH - 1);
+
+    double mean = 0;
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        mean += (window_samples[i] >> (32 - I2S_MIC_BIT_DEPTH)) / full_scale;
+    }
+    mean /= FFT_SAMPLES;
+
+    const double *a = WINDOW_LIMITS[type].coeffs;
+    double max_error = 0;
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        double angle = 2 * PI * i / FFT_SAMPLES;
+        double w = a[0] - a[1] * cos(angle) + a[2] * cos(2 * angle) - a[3] * cos(3 * angle) + a[4] * cos(4 * angle);
+        double ref = ((window_samples[i] >> (32 - I2S_MIC_BIT_DEPTH)) / full_scale - mean) * w;
+        max_error = max(max_error, fabs(fft_input[i] - ref));
+    }
+    return 20 * log10(max_error);
+}
+
+// The tone's amplitude in dB relative to BENCH_TONE_AMPLITUDE, taken as the largest bin
+static double calc_peak_db(const double *amplitudes) {
+    double peak = 0;
+    for (int i = 0; i < FFT_SAMPLES / 2 - 1; i++) {
+        peak = max(peak, amplitudes[i]);
+    }
+    return 20 * log10(peak / BENCH_TONE_AMPLITUDE);
+}
+
+// The largest bin at least BENCH_LEAKAGE_BINS from the tone at bin and from DC, in dB relative to
+// BENCH_TONE_AMPLITUDE. A tone halfway between two bins does not average to zero over the FFT, so the DC removal
+// subtracts part of it, and the window's own main lobe around DC would otherwise be counted as leakage.
+static double calc_leakage_db(const double *amplitudes, double bin) {
+    double leakage = 0;
+    for (int i = BENCH_LEAKAGE_BINS - 1; i < FFT_SAMPLES / 2 - 1; i++) {  // amplitudes start at bin 1
+        if (fabs(i + 1 - bin) >= BENCH_LEAKAGE_BINS) {
+            leakage = max(leakage, amplitudes[i]);
+        }
+    }
+    return 20 * log10(leakage / BENCH_TONE_AMPLITUDE);
+}
+
+// Checks one window on one FFT path, printing the results. Returns true if they are all within the window's limits,
+// with magnitude_tol_db of extra error allowed in the amplitudes.
+static bool check_window(const char *path_name, run_window_fn run_window, double magnitude_tol_db, FFTWindowType type) {
+    static int32_t samples[WINDOW_BENCH_SAMPLES];
+    static double fft_input[FFT_SAMPLES];
+    static double amplitudes[FFT_SAMPLES / 2 - 1];
+    static double amplitudes_no_dc[FFT_SAMPLES / 2 - 1];
+    const window_limits_t &limits = WINDOW_LIMITS[type];
+
+    // A tone centered on a bin, with and without a DC offset
+    make_tone(BENCH_TONE_BIN, 0, samples);
+    run_window(type, samples, fft_input, amplitudes_no_dc);
+    make_tone(BENCH_TONE_BIN, BENCH_DC_OFFSET, samples);
+    run_window(type, samples, fft_input, amplitudes);
+
+    double input_db = calc_input_error_db(type, samples, fft_input);
+    double max_dc_diff = 0;
+    for (int i = 0; i < FFT_SAMPLES / 2 - 1; i++) {
+        max_dc_diff = max(max_dc_diff, fabs(amplitudes[i] - amplitudes_no_dc[i]));
+    }
+    double dc_db = 20 * log10(max(max_dc_diff, 1e-12) / BENCH_TONE_AMPLITUDE);
+    double peak_db = calc_peak_db(amplitudes);
+
+    // A tone halfway between two bins, the worst case for both scalloping and leakage
+    make_tone(BENCH_TONE_BIN + 0.5, BENCH_DC_OFFSET, samples);
+    run_window(type, samples, fft_input, amplitudes);
+    double scallop_db = calc_peak_db(amplitudes);
+    double leakage_db = calc_leakage_db(amplitudes, BENCH_TONE_BIN + 0.5);
+
+    // This tone is not periodic in the FFT size, so unlike the first it also shows if the samples are out of order
+    input_db = max(input_db, calc_input_error_db(type, samples, fft_input));
+
+    bool passed = (input_db <= limits.max_input_db) && (dc_db <= limits.max_dc_db) &&
+                  (fabs(peak_db) <= limits.max_peak_db + magnitude_tol_db) &&
+                  (scallop_db >= limits.min_scallop_db - magnitude_tol_db) &&
+                  (leakage_db <= limits.max_leakage_db + magnitude_tol_db);
+    print("%-12s %-16s input error: %6.1f dB, DC rejection: %6.1f dB, peak error: %+.3f dB, scallop: %+.2f dB, "
+          "leakage: %6.1f dB%s\n",
+          path_name, get_fft_window_name(type), input_db, dc_db, peak_db, scallop_db, leakage_db,
+          passed ? "" : "  FAIL");
+    return passed;
+}
+
+int main() {
+    print("FFT windows: FFT_SAMPLES %d, FFT_HOP_SAMPLES %d, tone at bin %d, leakage from %d bins\n", FFT_SAMPLES,
+          FFT_HOP_SAMPLES, BENCH_TONE_BIN, BENCH_LEAKAGE_BINS);
+
+    bool passed = true;
+    for (int type = 0; type < FFT_WINDOW_MAX; type++) {
+        passed &= check_window("float", run_float_window, 0, FFTWindowType(type));
+        passed &= check_window("fixed-point", run_fixed_point_window, BENCH_FIXED_MAGNITUDE_DB, FFTWindowType(type));
+    }
+
+    if (!passed) {
+        print("FAIL: a window is outside its limits\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#ifndef _WINDOW_BENCH_H
+#define _WINDOW_BENCH_H
+
+#include <Arduino.h>
+
+#include "AudioSource.h"
+#include "Constants.h"
+
+#define WINDOW_BENCH_SAMPLES (FFT_SAMPLES + FFT_HOP_SAMPLES)  // samples loaded for each FFT, see run_float_window()
+
+// Supplies the samples of one test signal, in order
+class SignalAudioSource : public AudioSource {
+   public:
+    bool init() override {
+        return true;
+    }
+
+    int read(int32_t *buffer, int num_samples) override {
+        num_samples = min(num_samples, WINDOW_BENCH_SAMPLES - _pos);
+        memcpy(buffer, &_samples[_pos], num_samples * sizeof(int32_t));
+        _pos += num_samples;
+        return num_samples;
+    }
+
+    // Starts handing out samples, which must hold WINDOW_BENCH_SAMPLES samples
+    void set_samples(const int32_t *samples) {
+        _samples = samples;
+        _pos = 0;
+    }
+
+   private:
+    const int32_t *_samples = NULL;
+    int _pos = 0;
+};
+
+// Loads samples into the AudioProcessor's sample history and runs the FFT with the given window. The first
+// FFT_SAMPLES samples are loaded with get_audio_samples() and the rest with get_audio_samples_gapless(), so the
+// history wraps around and the FFT covers the last FFT_SAMPLES samples.
+//      samples: WINDOW_BENCH_SAMPLES samples in the I2S mic's format
+//      fft_input: receives the FFT_SAMPLES windowed samples the FFT was run on, scaled to ±1.0
+//      amplitudes: receives the FFT_SAMPLES / 2 - 1 amplitudes from bin 1 up, with the window's gain undone
+void run_float_window(FFTWindowType type, const int32_t *samples, double *fft_input, double *amplitudes);
+
+// As run_float_window(), with the fixed-point FFT (see bench/window_bench_fixed.cpp).
+void run_fixed_point_window(FFTWindowType type, const int32_t *samples, double *fft_input, double *amplitudes);
+
+#endif  // _WINDOW_BENCH_H
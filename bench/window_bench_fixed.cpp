@@ -0,0 +1,43 @@
+// The fixed-point build of the AudioProcessor for bench/window_bench.cpp. As with the float build there, the
+// AudioProcessor is compiled into this file with its private members opened up, so the bench can read its FFT input
+// and amplitudes, and it is renamed so it can be linked into the same program.
+#include <Arduino.h>
+
+#include "AudioSource.h"
+#include "BeatDetector.h"
+#include "Constants.h"
+#include "FFTWindow.h"
+#include "Filterbank.h"
+#include "FixedFFT.h"
+#include "Resampler.h"
+#include "Utils.h"
+#include "fft.h"
+#include "window_bench.h"
+
+#define FFT_FIXED_POINT
+#define AudioProcessor FixedPointAudioProcessor
+#define private public
+#include "AudioProcessor.cpp"
+#undef private
+#undef AudioProcessor
+
+void run_fixed_point_window(FFTWindowType type, const int32_t *samples, double *fft_input, double *amplitudes) {
+    static SignalAudioSource source;
+    static FixedPointAudioProcessor ap = FixedPointAudioProcessor(false, false, false, false, &source);
+
+    source.set_samples(samples);
+    ap._window = get_fft_window(type);
+    ap.get_audio_samples();
+    ap.get_audio_samples_gapless();
+
+    ap._load_fft_input();
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        fft_input[i] = double(ap._q_amplitudes[i]) / (1 << FIXED_FFT_INPUT_BITS);
+    }
+
+    ap._perform_fft();  // loads the FFT input again
+    double scale = double(ap._window->inv_gain) / (1 << FFT_WINDOW_GAIN_Q_BITS) / (1 << FIXED_FFT_INPUT_BITS);
+    for (int i = 0; i < FFT_SAMPLES / 2 - 1; i++) {
+        amplitudes[i] = ap._q_amplitudes[i] * scale;
+    }
+}
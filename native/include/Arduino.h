@@ -0,0 +1,48 @@
+#ifndef _ARDUINO_H
+#define _ARDUINO_H
+
+// Minimal stand-in for the ESP32 Arduino core, covering only what the audio pipeline uses so it can be built
+// and benchmarked on a host machine (see [env:native] in platformio.ini). Implemented in native/src/Arduino.cpp.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+#define PI 3.1415926535897932384626433832795
+
+#define PROGMEM
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Time since the program started
+unsigned long millis();
+unsigned long micros();
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+// Returns a random number in [min_val, max_val)
+long random(long max_val);
+long random(long min_val, long max_val);
+
+// ESP-IDF types and macros used alongside the Arduino core
+typedef int esp_err_t;
+typedef uint32_t TickType_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define portMAX_DELAY 0xFFFFFFFF
+
+#define BIT(nr) (1UL << (nr))
+#define REG_SET_BIT(reg, bit) ((void)(reg), (void)(bit))  // no peripheral registers on the host
+
+#endif  // _ARDUINO_H
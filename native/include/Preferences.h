@@ -0,0 +1,7 @@
+#ifndef _PREFERENCES_H
+#define _PREFERENCES_H
+
+// Utils.h declares functions that take a Preferences, but nothing in the native build uses non-volatile storage.
+class Preferences;
+
+#endif  // _PREFERENCES_H
@@ -0,0 +1,56 @@
+#ifndef _DRIVER_I2S_H
+#define _DRIVER_I2S_H
+
+#include <Arduino.h>
+
+// Stand-in for the ESP-IDF I2S driver. There is no microphone on the host, so i2s_driver_install() always
+// fails and I2SAudioSource::init() reports an error; use a WavAudioSource or ToneAudioSource instead.
+
+typedef int i2s_port_t;
+#define I2S_NUM_0 0
+#define I2S_PIN_NO_CHANGE -1
+
+typedef enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_RX = 4,
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_ONLY_LEFT = 4,
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_I2S = 1,
+    I2S_COMM_FORMAT_I2S_MSB = 2,
+} i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    int sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+typedef struct {
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t *i2s_config, int queue_size, void *i2s_queue);
+esp_err_t i2s_set_pin(i2s_port_t i2s_num, const i2s_pin_config_t *pin);
+esp_err_t i2s_read(i2s_port_t i2s_num, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait);
+
+#endif  // _DRIVER_I2S_H
@@ -0,0 +1,40 @@
+#ifndef _FFT_H
+#define _FFT_H
+
+// Stand-in for the ESP32 fft library (https://github.com/fakufaku/esp32-fft), with the same API and output
+// format. Only the forward real FFT used by AudioProcessor is implemented, see native/src/fft.cpp.
+
+typedef enum {
+    FFT_REAL,
+    FFT_COMPLEX,
+} fft_type_t;
+
+typedef enum {
+    FFT_FORWARD,
+    FFT_BACKWARD,
+} fft_direction_t;
+
+#define FFT_OWN_INPUT_MEM 1
+#define FFT_OWN_OUTPUT_MEM 2
+
+typedef struct {
+    int size;                // FFT size, must be a power of two
+    float *input;            // input buffer of size floats
+    float *output;           // output buffer of size floats
+    float *twiddle_factors;  // cos/sin pairs for each of the size / 2 twiddles
+    int flags;               // FFT_OWN_*_MEM if the buffers were allocated by fft_init()
+    fft_type_t type;
+    fft_direction_t direction;
+} fft_config_t;
+
+// Creates an FFT plan. If input or output is NULL, a buffer is allocated and owned by the plan.
+fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, float *input, float *output);
+
+// Frees the plan and any buffers it owns.
+void fft_destroy(fft_config_t *config);
+
+// Runs the FFT. For a forward real FFT the output is packed as
+// [ X[0], X[N/2], Re(X[1]), Im(X[1]), ..., Re(X[N/2-1]), Im(X[N/2-1]) ]
+void fft_execute(fft_config_t *config);
+
+#endif  // _FFT_H
@@ -0,0 +1,33 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+long random(long max_val) {
+    return random(0, max_val);
+}
+
+long random(long min_val, long max_val) {
+    if (min_val >= max_val) {
+        return min_val;
+    }
+    return min_val + rand() % (max_val - min_val);
+}
@@ -0,0 +1,12 @@
+#include "Utils.h"
+
+#include <stdarg.h>
+
+// The rest of src/Utils.cpp needs WiFi and Preferences, so the native build only gets print(), which writes to
+// stdout instead of the serial port.
+void print(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
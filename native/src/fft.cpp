@@ -0,0 +1,131 @@
+#include <fft.h>
+
+#include <Arduino.h>
+
+// Runs an in-place radix-2 FFT on n interleaved complex values. twiddle_stride is the spacing in the twiddle
+// table between the twiddles of an n point FFT, i.e. 1 if the table was made for n points, 2 for n * 2 points.
+static void complex_fft(float *x, int n, const float *twiddles, int twiddle_stride) {
+    // Bit-reversal permutation
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[2 * i], x[2 * j]);
+            std::swap(x[2 * i + 1], x[2 * j + 1]);
+        }
+    }
+
+    // Butterflies
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int step = (n / len) * twiddle_stride;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = twiddles[2 * k * step];
+                float wi = twiddles[2 * k * step + 1];
+                float *a = &x[2 * (i + k)];
+                float *b = &x[2 * (i + k + half)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+// Runs a real FFT of n points as an n / 2 point complex FFT on the even/odd samples, then splits the result
+static void real_fft(const float *input, float *output, const float *twiddles, int n) {
+    int m = n / 2;
+
+    if (output != input) {
+        memcpy(output, input, n * sizeof(float));  // real samples pair up as interleaved complex values
+    }
+    complex_fft(output, m, twiddles, 2);
+
+    float z0_real = output[0];
+    float z0_imag = output[1];
+    output[0] = z0_real + z0_imag;  // X[0]
+    output[1] = z0_real - z0_imag;  // X[N/2]
+
+    for (int k = 1; k <= m / 2; k++) {
+        int j = m - k;
+        float even_real = (output[2 * k] + output[2 * j]) / 2;
+        float even_imag = (output[2 * k + 1] - output[2 * j + 1]) / 2;
+        float odd_real = (output[2 * k + 1] + output[2 * j + 1]) / 2;
+        float odd_imag = (output[2 * j] - output[2 * k]) / 2;
+
+        float wr = twiddles[2 * k];
+        float wi = twiddles[2 * k + 1];
+        float tr = odd_real * wr - odd_imag * wi;
+        float ti = odd_real * wi + odd_imag * wr;
+
+        output[2 * k] = even_real + tr;  // X[k]
+        output[2 * k + 1] = even_imag + ti;
+        output[2 * j] = even_real - tr;  // X[N/2 - k], using the conjugate symmetry of the even/odd spectra
+        output[2 * j + 1] = ti - even_imag;
+    }
+}
+
+fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, float *input, float *output) {
+    if (size < 4 || (size & (size - 1)) != 0 || direction != FFT_FORWARD) {
+        return NULL;  // only the forward transforms are implemented
+    }
+
+    fft_config_t *config = (fft_config_t *)malloc(sizeof(fft_config_t));
+    config->size = size;
+    config->type = type;
+    config->direction = direction;
+    config->flags = 0;
+
+    int num_floats = (type == FFT_REAL) ? size : size * 2;
+    config->input = input;
+    if (config->input == NULL) {
+        config->input = (float *)calloc(num_floats, sizeof(float));
+        config->flags |= FFT_OWN_INPUT_MEM;
+    }
+    config->output = output;
+    if (config->output == NULL) {
+        config->output = (float *)calloc(num_floats, sizeof(float));
+        config->flags |= FFT_OWN_OUTPUT_MEM;
+    }
+
+    // exp(-2 pi i k / size) for k in [0, size / 2)
+    config->twiddle_factors = (float *)malloc(size * sizeof(float));
+    for (int k = 0; k < size / 2; k++) {
+        config->twiddle_factors[2 * k] = cos(2 * PI * k / size);
+        config->twiddle_factors[2 * k + 1] = -sin(2 * PI * k / size);
+    }
+
+    return config;
+}
+
+void fft_destroy(fft_config_t *config) {
+    if (config == NULL) {
+        return;
+    }
+    if (config->flags & FFT_OWN_INPUT_MEM) {
+        free(config->input);
+    }
+    if (config->flags & FFT_OWN_OUTPUT_MEM) {
+        free(config->output);
+    }
+    free(config->twiddle_factors);
+    free(config);
+}
+
+void fft_execute(fft_config_t *config) {
+    if (config->type == FFT_REAL) {
+        real_fft(config->input, config->output, config->twiddle_factors, config->size);
+    } else {
+        if (config->output != config->input) {
+            memcpy(config->output, config->input, config->size * 2 * sizeof(float));
+        }
+        complex_fft(config->output, config->size, config->twiddle_factors, 1);
+    }
+}
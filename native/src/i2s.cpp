@@ -0,0 +1,14 @@
+#include <driver/i2s.h>
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t *i2s_config, int queue_size, void *i2s_queue) {
+    return ESP_FAIL;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t i2s_num, const i2s_pin_config_t *pin) {
+    return ESP_FAIL;
+}
+
+esp_err_t i2s_read(i2s_port_t i2s_num, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait) {
+    *bytes_read = 0;
+    return ESP_FAIL;
+}
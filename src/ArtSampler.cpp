@@ -0,0 +1,75 @@
+#include "ArtSampler.h"
+
+#include "GammaTable.h"
+
+// Constructor
+ArtSampler::ArtSampler(uint16_t *palette_rgb565) {
+    _palette_rgb565 = palette_rgb565;
+    begin(0, 0);
+}
+
+void ArtSampler::begin(int src_w, int src_h) {
+    _src_w = src_w;
+    _src_h = src_h;
+    memset(_sums, 0, sizeof(_sums));
+    memset(_counts, 0, sizeof(_counts));
+    if (_palette_rgb565) {
+        memset(_palette_rgb565, 0, PALETTE_ART_SIZE * PALETTE_ART_SIZE * sizeof(uint16_t));  // black pixels are ignored
+    }
+}
+
+void ArtSampler::add_block(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap) {
+    for (int row = 0; row < h; row++) {
+        int src_y = y + row;
+        if (src_y < 0 || src_y >= _src_h) {
+            continue;
+        }
+        int grid_y = src_y * GRID_H / _src_h;
+        int palette_y = src_y * PALETTE_ART_SIZE / _src_h;
+        bool palette_row = (src_y == (palette_y * _src_h + PALETTE_ART_SIZE - 1) / PALETTE_ART_SIZE);  // first row in the cell
+
+        for (int col = 0; col < w; col++) {
+            int src_x = x + col;
+            if (src_x < 0 || src_x >= _src_w) {
+                continue;
+            }
+            uint16_t rgb565 = bitmap[row * w + col];
+
+            int grid_x = src_x * GRID_W / _src_w;
+            uint32_t *sums = _sums[grid_y][grid_x];
+            sums[0] += (rgb565 >> 11) & 0x1F;
+            sums[1] += (rgb565 >> 5) & 0x3F;
+            sums[2] += rgb565 & 0x1F;
+            _counts[grid_y][grid_x]++;
+
+            if (palette_row) {
+                int palette_x = src_x * PALETTE_ART_SIZE / _src_w;
+                if (src_x == (palette_x * _src_w + PALETTE_ART_SIZE - 1) / PALETTE_ART_SIZE) {  // first column in the cell
+                    _palette_rgb565[palette_y * PALETTE_ART_SIZE + palette_x] = rgb565;
+                }
+            }
+        }
+    }
+}
+
+void ArtSampler::finish(CRGB *art) {
+    static const uint32_t max_vals[3] = {0x1F, 0x3F, 0x1F};
+
+    for (int row = 0; row < GRID_H; row++) {
+        for (int col = 0; col < GRID_W; col++) {
+            uint32_t count = _counts[row][col];
+            if (count == 0) {
+                art[row * GRID_W + col] = CRGB::Black;
+                continue;
+            }
+
+            // Mean of each channel, scaled to 8 bits and rounded
+            uint8_t rgb888_arr[3];
+            for (int c = 0; c < 3; c++) {
+                uint32_t denom = count * max_vals[c];
+                rgb888_arr[c] = (_sums[row][col][c] * 255 + denom / 2) / denom;
+            }
+            art[row * GRID_W + col] = rgb888_to_led_crgb(rgb888_arr);
+        }
+    }
+}
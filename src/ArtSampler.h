@@ -0,0 +1,43 @@
+#ifndef _ARTSAMPLER_H
+#define _ARTSAMPLER_H
+
+#include <Arduino.h>
+
+#include "Constants.h"
+#include "FastLED.h"
+
+// The ArtSampler class downsamples album art while it is being decoded, so the full resolution image never needs
+// to be stored. The JPG decoder hands over the image one block (MCU) of RGB565 pixels at a time, through
+// add_block(). Each pixel is added to the sums for the LED it falls in, so each LED ends up with the average
+// (box filter) of the pixels it covers rather than a single pixel that may not represent them. Pixels are also
+// point sampled into a PALETTE_ART_SIZE x PALETTE_ART_SIZE buffer for calculating the palette, taking the first
+// pixel of each cell so that the palette sees real colors from the art rather than averages.
+//
+// Any source size works, as the pixels are mapped to LEDs and palette cells by their position in the image. The
+// averages are taken of the gamma encoded values, and converted to LED colors with the LED gamma by finish().
+class ArtSampler {
+   public:
+    // Constructor, accepts the buffer that will hold the pixels for the palette, with PALETTE_ART_SIZE x
+    // PALETTE_ART_SIZE RGB565 values.
+    ArtSampler(uint16_t *palette_rgb565);
+
+    // Clears the sums to start sampling an image of the given size, as it will be passed to add_block().
+    void begin(int src_w, int src_h);
+
+    // Adds a block of w x h RGB565 pixels at (x, y) in the image. Pixels outside of the image are ignored.
+    void add_block(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap);
+
+    // Converts the averages to LED colors, storing GRID_W x GRID_H colors in art in row major order, starting
+    // with the top left. LEDs not covered by any pixels are black.
+    void finish(CRGB *art);
+
+   private:
+    uint16_t *_palette_rgb565;
+    int _src_w = 0;
+    int _src_h = 0;
+
+    uint32_t _sums[GRID_H][GRID_W][3];  // sum of the RGB565 channel values of the pixels covered by each LED
+    uint16_t _counts[GRID_H][GRID_W];   // number of pixels covered by each LED
+};
+
+#endif  // _ARTSAMPLER_H
@@ -2,69 +2,71 @@
 
 #include "Utils.h"
 
+static const double VOL_THRESH = pow(10, VOL_THRESH_DB / 20.0);  // VOL_THRESH_DB as an amplitude, to avoid a log10 per frame
+
 // Constructor to define FFT post-processing
-AudioProcessor::AudioProcessor(bool white_noise_eq, bool a_weighting_eq, bool perceptual_binning, bool volume_scaling) {
+AudioProcessor::AudioProcessor(bool white_noise_eq, bool a_weighting_eq, bool perceptual_binning, bool volume_scaling, AudioSource *source) {
     _WHITE_NOISE_EQ = white_noise_eq;
     _A_WEIGHTING_EQ = a_weighting_eq;
     _PERCEPTUAL_BINNING = perceptual_binning;
     _VOLUME_SCALING = volume_scaling;
 
-    if (!_i2s_init()) {
+    if (source == NULL) {
+        _source = new I2SAudioSource();
+        _owns_source = true;
+    } else {
+        _source = source;
+    }
+
+    if (!_source->init()) {
         _is_active = false;
     } else {
         _is_active = true;
     }
     _init_variables();
+    _init_intensity_table();
+    set_window(FFT_WINDOW);
+
+    // The FFT results skip the DC term, so the first amplitude is at one bin width
+    double bin_width = double(I2S_SAMPLE_RATE) / FFT_SAMPLES;
+    _beat_detector = new BeatDetector(FFT_SAMPLES / 2 - 1, bin_width, bin_width, double(I2S_SAMPLE_RATE) / FFT_HOP_SAMPLES);
+#ifdef FFT_FIXED_POINT
+    _fixed_fft = new FixedFFT(FFT_SAMPLES);
+    _init_fixed_point_tables();
+#else
     _real_fft_plan = fft_init(FFT_SAMPLES, FFT_REAL, FFT_FORWARD, _v_real, _v_imag);
+#endif
 }
 
 // Destructor (make sure to destroy the fft)
 AudioProcessor::~AudioProcessor() {
+#ifdef FFT_FIXED_POINT
+    delete _fixed_fft;
+#else
     fft_destroy(_real_fft_plan);
+#endif
+    if (_owns_source) {
+        delete _source;
+    }
+    delete _filterbank;
+    delete _resampler;
+    delete _beat_detector;
 }
 
-// Return true if the audio processor initialization succeeded
-bool AudioProcessor::is_active() {
-    return _is_active;
+// Select the window to apply before the FFT
+void AudioProcessor::set_window(FFTWindowType type) {
+    _window = get_fft_window(type);
+    print("FFT window set to %s\n", get_fft_window_name(type));
 }
 
-// Initialize I2S for audio ADC
-bool AudioProcessor::_i2s_init() {
-    i2s_config_t i2s_config = {
-        .mode = i2s_mode_t(I2S_MODE_MASTER | I2S_MODE_RX),
-        .sample_rate = I2S_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,  // I2S mic transfer only works with 32b
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = i2s_comm_format_t(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB),
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 4,
-        .dma_buf_len = FFT_SAMPLES,
-        .use_apll = false,
-        .tx_desc_auto_clear = false,
-        .fixed_mclk = 0};
-
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = PIN_I2S_BCK,          // Serial Clock (SCK)
-        .ws_io_num = PIN_I2S_WS,            // Word Select (WS)
-        .data_out_num = I2S_PIN_NO_CHANGE,  // not used (only for speakers)
-        .data_in_num = PIN_I2S_DIN          // Serial Data (SD)
-    };
-
-    // Workaround for SPH0645 timing issue (see comments: https://hackaday.io/project/162059-street-sense/log/160705-new-i2s-microphone)
-    REG_SET_BIT(I2S_TIMING_REG(I2S_PORT), BIT(9));
-    REG_SET_BIT(I2S_CONF_REG(I2S_PORT), I2S_RX_MSB_SHIFT);
-
-    if (i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL) != ESP_OK) {
-        print("Audio Error (i2s_driver_install): Check that microphone is connected to Audio In port\n");
-        return false;
-    }
-    if (i2s_set_pin(I2S_PORT, &pin_config) != ESP_OK) {
-        print("Audio Error (i2s_set_pin): Check that microphone is connected to Audio In port\n");
-        return false;
-    }
+// Select the filterbank to use for intensity calculations
+void AudioProcessor::set_filterbank(FilterbankScale scale) {
+    _filterbank_scale = scale;
+}
 
-    print("Audio I2S init complete\n");
-    return true;
+// Return true if the audio processor initialization succeeded
+bool AudioProcessor::is_active() {
+    return _is_active;
 }
 
 // Initialize instance variables
@@ -73,12 +75,19 @@ void AudioProcessor::_init_variables() {
 
     // Initialize arrays
     memset(_intensity, 0, sizeof(_intensity));
-
-    memset(_last_intensity, 0, sizeof(_last_intensity));
     memset(_fft_interp, 0, sizeof(_fft_interp));
 
     memset(_v_real, 0, sizeof(_v_real));
+    memset(_history, 0, sizeof(_history));
+    _history_pos = 0;
+    _history_sum = 0;
+    _history_sum_sq = 0;
+
+#ifdef FFT_FIXED_POINT
+    memset(_q_amplitudes, 0, sizeof(_q_amplitudes));
+#else
     memset(_v_imag, 0, sizeof(_v_imag));
+#endif
 
     memset(_fft_bin, 0, sizeof(_fft_bin));
 
@@ -92,97 +101,110 @@ void AudioProcessor::_init_variables() {
     print("Audio processor variables initialized\n");
 }
 
-// Get audio data from I2S mic (non-overlapping)
-void AudioProcessor::get_audio_samples() {
-    int samples_to_read = FFT_SAMPLES;
-
-    int32_t audio_val, audio_val_avg;
-    int32_t audio_val_sum = 0;
-    int32_t buffer[samples_to_read];
-    size_t bytes_read = 0;
-    int samples_read = 0;
+// The LED response curve, raised to a power to increase sensitivity and scaled into discrete brightness levels
+void AudioProcessor::_init_intensity_table() {
+    for (int i = 0; i < INTENSITY_LUT_SIZE; i++) {
+        double val = double(i) / (INTENSITY_LUT_SIZE - 1);
+        _intensity_lut[i] = uint8_t(round(pow(val, FFT_SCALE_POWER) * BRIGHT_LEVELS));
+    }
+}
 
-    // First audio samples are junk, so prime the system then delay
-    if (_audio_first_loop) {
-        i2s_read(I2S_PORT, (void *)buffer, sizeof(buffer), &bytes_read, portMAX_DELAY);  // no timeout
-        delay(1000);
+#ifdef FFT_FIXED_POINT
+// Converts the noise floor and EQ tables from Constants.h into fixed-point units so the post-processing
+// can be done with integer math
+void AudioProcessor::_init_fixed_point_tables() {
+    for (int i = 0; i < FFT_SAMPLES / 2; i++) {
+        _q_fft_remove[i] = int32_t(round(double(FFT_REMOVE[i]) * (1 << FIXED_FFT_INPUT_BITS)));
+        if (FFT_EQ[i] > 0) {
+            _q_fft_eq[i] = uint16_t(round(255.0 * 256 / FFT_EQ[i]));  // Q8 gain
+        } else {
+            _q_fft_eq[i] = 256;  // unity gain for bins without calibration data
+        }
     }
-    i2s_read(I2S_PORT, (void *)buffer, sizeof(buffer), &bytes_read, portMAX_DELAY);  // no timeout
+}
+#endif
+
+// Read raw samples from the audio source
+int AudioProcessor::_read_samples(int32_t *buffer, int samples_to_read) {
+    int samples_read = _source->read(buffer, samples_to_read);
     _audio_first_loop = false;
 
     // Check that we got the correct number of samples
-    samples_read = int(int(bytes_read) / sizeof(buffer[0]));  // since a sample is 32 bits (4 bytes)
-    if (int(samples_read) != samples_to_read) {
-        print("Warning: %d audio samples read, %d expected!\n", int(samples_read), int(samples_to_read));
+    if (samples_read != samples_to_read) {
+        print("Warning: %d audio samples read, %d expected!\n", samples_read, samples_to_read);
     }
 
-    uint8_t bit_shift_amount = 32 - I2S_MIC_BIT_DEPTH;
-
-    // Bitshift the data
-    for (int i = 0; i < int(samples_read); i++) {
-        audio_val = buffer[i] >> bit_shift_amount;
-        audio_val_sum += audio_val;
+    return samples_read;
+}
 
-        _v_real[i] = double(audio_val);
-        _v_imag[i] = 0;
-    }
+// Reads new samples from the audio source directly into the sample history, overwriting the oldest samples
+void AudioProcessor::_push_samples(int samples_to_read) {
+    uint8_t bit_shift_amount = 32 - I2S_MIC_BIT_DEPTH;
 
-    double scale_val = (1 << (I2S_MIC_BIT_DEPTH - 1));
-    audio_val_avg = double(audio_val_sum) / samples_read;  // DC offset
-    for (int i = 0; i < int(samples_read); i++) {
-        _v_real[i] = (_v_real[i] - audio_val_avg) / scale_val;  // Subtract DC offset and scale to ±1
-    }
-}
+    while (samples_to_read > 0) {
+        // Read in contiguous chunks so we never run off the end of the history
+        int chunk_len = min(samples_to_read, FFT_SAMPLES - _history_pos);
+        int32_t *chunk = &_history[_history_pos];
 
-// Get audio data from I2S mic (overlapping)
-void AudioProcessor::get_audio_samples_gapless() {
-    int samples_to_read = FFT_SAMPLES / 2;
-    int offset = FFT_SAMPLES - samples_to_read;
+        // Remove the samples we are about to overwrite from the running sums
+        for (int i = 0; i < chunk_len; i++) {
+            _history_sum -= chunk[i];
+            _history_sum_sq -= int64_t(chunk[i]) * chunk[i];
+        }
 
-    int32_t audio_val, audio_val_avg;
-    int32_t audio_val_sum = 0;
-    int32_t buffer[samples_to_read];
-    size_t bytes_read = 0;
-    int samples_read = 0;
+        int samples_read = _read_samples(chunk, chunk_len);
 
-    // First audio samples are junk, so prime the system then delay
-    if (_audio_first_loop) {
-        i2s_read(I2S_PORT, (void *)buffer, sizeof(buffer), &bytes_read, portMAX_DELAY);  // no timeout
-        delay(1000);
-    }
-    i2s_read(I2S_PORT, (void *)buffer, sizeof(buffer), &bytes_read, portMAX_DELAY);  // no timeout
-    _audio_first_loop = false;
+        // Bitshift the new data and add it to the running sums
+        for (int i = 0; i < chunk_len; i++) {
+            int32_t audio_val = (i < samples_read) ? (chunk[i] >> bit_shift_amount) : 0;  // zero out anything we failed to read
+            chunk[i] = audio_val;
+            _history_sum += audio_val;
+            _history_sum_sq += int64_t(audio_val) * audio_val;
+        }
 
-    // Check that we got the correct number of samples
-    samples_read = int(int(bytes_read) / sizeof(buffer[0]));  // since a sample is 32 bits (4 bytes)
-    if (int(samples_read) != samples_to_read) {
-        print("Warning: %d audio samples read, %d expected!\n", int(samples_read), int(samples_to_read));
+        _history_pos = (_history_pos + chunk_len) & (FFT_SAMPLES - 1);
+        samples_to_read -= chunk_len;
     }
+}
 
-    uint8_t bit_shift_amount = 32 - I2S_MIC_BIT_DEPTH;
-
-    // Bitshift the data
-    for (int i = 0; i < int(samples_read); i++) {
-        audio_val = buffer[i] >> bit_shift_amount;
-        audio_val_sum += audio_val;
+// Get audio data from audio source (non-overlapping)
+void AudioProcessor::get_audio_samples() {
+    _push_samples(FFT_SAMPLES);
+}
 
-        _v_real[i] = _v_real[i + offset];         // shift previous data forward
-        _v_real[i + offset] = double(audio_val);  // put new data in back of array
-        _v_imag[i] = 0;
-    }
+// Get audio data from audio source (overlapping)
+void AudioProcessor::get_audio_samples_gapless() {
+    _push_samples(FFT_HOP_SAMPLES);
+}
 
-    double scale_val = (1 << (I2S_MIC_BIT_DEPTH - 1));
-    audio_val_avg = double(audio_val_sum) / samples_read;  // DC offset
-    for (int i = 0; i < int(samples_read); i++) {
-        _v_real[i + offset] = (_v_real[i + offset] - audio_val_avg) / scale_val;  // Subtract DC offset and scale to ±1
+// Copies the sample history, oldest sample first, into the FFT input while subtracting the DC offset,
+// applying the window and scaling to the FFT's input range, all in a single pass.
+void AudioProcessor::_load_fft_input() {
+    int32_t audio_val_avg = int32_t(_history_sum / FFT_SAMPLES);  // DC offset over the whole window
+    const int16_t *window = _window->coeffs;
+    int pos = _history_pos;
+
+#ifdef FFT_FIXED_POINT
+    int32_t *fft_input = _q_amplitudes;  // re-use the amplitude array as scratch space for the scaled input
+    uint8_t fft_shift_amount = FFT_WINDOW_Q_BITS - (FIXED_FFT_INPUT_BITS - (I2S_MIC_BIT_DEPTH - 1));  // Q15 window product to FFT input range
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        fft_input[i] = int32_t((int64_t(_history[pos] - audio_val_avg) * window[i]) >> fft_shift_amount);  // subtract DC offset, window and scale
+        pos = (pos + 1) & (FFT_SAMPLES - 1);
+    }
+#else
+    float scale_val = 1.0 / (double(1 << (I2S_MIC_BIT_DEPTH - 1)) * (1 << FFT_WINDOW_Q_BITS));
+    for (int i = 0; i < FFT_SAMPLES; i++) {
+        _v_real[i] = float(_history[pos] - audio_val_avg) * window[i] * scale_val;  // subtract DC offset, window and scale to ±1 (in float, as the product overflows an int)
+        pos = (pos + 1) & (FFT_SAMPLES - 1);
     }
+#endif
 }
 
 // Use the current audio samples to calculate an instantaneous volume, then uses exponential
 // moving average to update the _avg_volume variable.
 void AudioProcessor::update_volume() {
     // Use exponential moving average, simpler than creating an actual moving avg array
-    _curr_volume = _calc_rms_scaled(_v_real, FFT_SAMPLES);
+    _curr_volume = _calc_rms_scaled();
 
     if (_audio_first_loop) {  // the first time through the loop, we have no history, so set the avg volume to the curr volume
         _avg_volume = _curr_volume;
@@ -228,12 +250,6 @@ void AudioProcessor::_setup_audio_bins() {
     double bin_width = double(I2S_SAMPLE_RATE) / FFT_SAMPLES;
     double nbins = FFT_SAMPLES / 2.0 - 1;
 
-    // We want to be conservative here and not pick up too much out-of-band noise. So use ceil and floor
-    _lowest_bass_bin = int(ceil(LOWEST_BASS_FREQ / bin_width) - 1);
-    _highest_bass_bin = int(floor(HIGHEST_BASS_FREQ / bin_width) - 1);
-    print("lowest bass bin = %d, lowest bass freq = %f\n", _lowest_bass_bin, (_lowest_bass_bin + 1) * bin_width);
-    print("highest bass bin = %d, highest bass freq = %f\n", _highest_bass_bin, (_highest_bass_bin + 1) * bin_width);
-
     print("freq_mult_per_band: %f, nyq_freq: %f, bin_width: %f, num_bins: %d\n", freq_mult_per_band, nyquist_freq, bin_width, int(round(nbins)));
 
     for (int band = 0; band < NUM_AUDIO_BANDS; band++) {
@@ -254,9 +270,83 @@ void AudioProcessor::_setup_audio_bins() {
     for (int i = 0; i < NUM_AUDIO_BANDS; i++) {
         print("%d, %d, %d\n", int(round(_bin_freqs[i])), int(round(_low_bins[i])), int(round(_high_bins[i])));
     }
+
+    // Pre-compute the range of FFT bins that falls in each band, so banding is a single pass over the FFT
+    _num_band_ranges = 0;
+    for (int band = 0; band < NUM_AUDIO_BANDS; band++) {
+        bin_range_t range = {.out = uint16_t(band), .start = 0, .end = 0, .start_weight = 1.0, .end_weight = 1.0};
+#ifdef AUDIO_BAND_EDGE_WEIGHTS
+        // Bin i is centered on i with a width of 1, and the bins at either edge are weighted by how much of them is in the band
+        double low = (band == 0) ? -0.5 : _low_bins[band];  // the first band includes the 0th bin
+        double high = _high_bins[band];
+        int start = int(floor(low + 0.5));
+        int end = min(int(ceil(high - 0.5)), FFT_SAMPLES / 2 - 1);
+        if (start == end) {
+            range.start_weight = high - low;
+        } else {
+            range.start_weight = (start + 0.5) - low;
+            range.end_weight = high - (end - 0.5);
+        }
+#else
+        // Bin i is in a band if round(low) < i <= round(high)
+        int start = (band == 0) ? 0 : int(round(_low_bins[band])) + 1;  // the first band includes the 0th bin
+        int end = int(round(_high_bins[band]));
+#endif
+        if (end < start) {  // skip bands too narrow to contain a bin
+            continue;
+        }
+        range.start = start;
+        range.end = end;
+        _band_ranges[_num_band_ranges++] = range;
+    }
+
+    _setup_perceptual_bins();
+}
+
+// GAMMA16_FFT maps each FFT bin to a perceptual bin and is monotonic, so each perceptual bin is fed by a run of
+// consecutive FFT bins. Only the lower half of the FFT bins are mapped, and mapped values are doubled to use the
+// full range of bins.
+void AudioProcessor::_setup_perceptual_bins() {
+    _num_perceptual_ranges = 0;
+    for (int i = 0; i < FFT_SAMPLES / 4; i++) {
+        int mapped_bin = GAMMA16_FFT[i] * 2;
+        if (mapped_bin >= FFT_SAMPLES / 2) {  // bins that map off the end of the array are dropped
+            break;
+        }
+
+        if (_num_perceptual_ranges > 0 && _perceptual_ranges[_num_perceptual_ranges - 1].out == mapped_bin) {
+            _perceptual_ranges[_num_perceptual_ranges - 1].end = i;  // extend the current run
+        } else {
+            _perceptual_ranges[_num_perceptual_ranges++] = {.out = uint16_t(mapped_bin), .start = uint16_t(i), .end = uint16_t(i), .start_weight = 1.0, .end_weight = 1.0};
+        }
+    }
+}
+
+void AudioProcessor::_apply_bin_ranges(const bin_range_t *ranges, int num_ranges, float *out) {
+    for (int r = 0; r < num_ranges; r++) {
+        const bin_range_t &range = ranges[r];
+
+        float sum = _v_real[range.start] * range.start_weight;
+        if (range.end > range.start) {
+            for (int i = range.start + 1; i < range.end; i++) {
+                sum += _v_real[i];
+            }
+            sum += _v_real[range.end] * range.end_weight;
+        }
+        out[range.out] += sum;
+    }
 }
 
 void AudioProcessor::_perform_fft() {
+    _load_fft_input();
+
+#ifdef FFT_FIXED_POINT
+    _fixed_fft->execute(_q_amplitudes);
+
+    // Amplitudes are in units of 1 << FIXED_FFT_INPUT_BITS, and skip the 0th (DC) term like the float path
+    _fixed_fft->get_amplitudes(_q_amplitudes);
+    _q_amplitudes[FFT_SAMPLES / 2 - 1] = 0;
+#else
     fft_execute(_real_fft_plan);
     // FFT results go into _v_imag, so we need to extract them and put them back int to _v_real
 
@@ -269,14 +359,16 @@ void AudioProcessor::_perform_fft() {
     //_v_real[0] = _v_imag[0] / FFT_SAMPLES;  // DC term is zeroth element
 
     // Other terms alternate between real & imag so we need to calculate the amplitude
+    float amplitude_scale = 2.0 / FFT_SAMPLES * _window->inv_gain / (1 << FFT_WINDOW_GAIN_Q_BITS);  // also undoes the window's coherent gain
     for (int i = 1; i < FFT_SAMPLES / 2; i++) {
-        double real, imag, magnitude, amplitude;
+        float real, imag, magnitude, amplitude;
         real = _v_imag[i * 2];      // index: 2, 4, 6, ... , (FFT_SAMPLES/2 - 1) * 2
         imag = _v_imag[i * 2 + 1];  // index: 3, 5, 7, ... , (FFT_SAMPLES/2 - 1) * 2 + 1
-        magnitude = sqrt(pow(real, 2) + pow(imag, 2));
-        amplitude = magnitude * 2 / FFT_SAMPLES;  // scale factor
+        magnitude = sqrtf(real * real + imag * imag);
+        amplitude = magnitude * amplitude_scale;  // scale factor
         _v_real[i - 1] = amplitude;               // skip the 0th term because it is the DC value, which we don't want to plot
     }
+#endif
 }
 
 // This method cleans up the FFT results and prepares them for LED intensity calculations.
@@ -289,8 +381,11 @@ void AudioProcessor::_postprocess_fft() {
     // 3. Apply A-weighting eq (optional)
     // 4. Apply perceptual binning (optional)
 
+#ifdef FFT_FIXED_POINT
+    float q_scale = 1.0 / (_max_fft_val * (1 << FIXED_FFT_INPUT_BITS));  // converts fixed-point amplitudes to normalized values
+#else
     double eq_mult, a_weighting_mult;
-    int curr_bin, mapped_bin;
+#endif
 
 #ifdef FFT_WHITE_NOISE_CAL
     static int counter = 0;
@@ -309,6 +404,24 @@ void AudioProcessor::_postprocess_fft() {
     _clear_fft_bin();  // clear out the fft_bin array as it has stale values
 
     for (int i = 0; i < FFT_SAMPLES / 2; i++) {
+#ifdef FFT_FIXED_POINT
+        int64_t amp = ((int64_t(_q_amplitudes[i]) * _window->inv_gain) >> FFT_WINDOW_GAIN_Q_BITS) - _q_fft_remove[i];  // undo window gain and remove noise
+        if (amp < 0) {
+            amp = 0;
+        }
+
+#ifdef FFT_WHITE_NOISE_CAL
+        cum_fft[i] += (amp * q_scale / cal_samples);
+#endif
+
+        if (_WHITE_NOISE_EQ) {  // apply white noise eq
+            amp = (amp * _q_fft_eq[i]) >> 8;
+        }
+        if (_A_WEIGHTING_EQ) {  // apply A-weighting eq, multiplying by 257 / 65536 approximates dividing by 255
+            amp = (amp * A_WEIGHTING[i] * 257) >> 16;
+        }
+        _v_real[i] = amp * q_scale;  // scale by max_val
+#else
         _v_real[i] = (double(_v_real[i]) - double(FFT_REMOVE[i])) / _max_fft_val;  // remove noise and scale by max_val
         if (_v_real[i] < 0) {
             _v_real[i] = 0;
@@ -326,35 +439,12 @@ void AudioProcessor::_postprocess_fft() {
             a_weighting_mult = (double(A_WEIGHTING[i]) / 255.0);
             _v_real[i] *= a_weighting_mult;
         }
-        // if (_PERCEPTUAL_BINNING) {           // apply perceptual binning, old version
-        //   curr_bin = i;
-        //   mapped_bin = pgm_read_byte(&GAMMA16_FFT[i]);
-
-        //   // accumulate FFT samples in the new mapped bin
-        //   _fft_bin[mapped_bin] += _v_real[curr_bin];
+#endif
+    }
 
-        if (_PERCEPTUAL_BINNING) {  // apply perceptual binning, only maps the lower half of the samples
-            if (i < FFT_SAMPLES / 4) {
-                curr_bin = i;
-                mapped_bin = GAMMA16_FFT[i] * 2;  // multiply by 2 to get the full mapping
+    if (_PERCEPTUAL_BINNING) {  // apply perceptual binning, only maps the lower half of the samples
+        _apply_bin_ranges(_perceptual_ranges, _num_perceptual_ranges, _fft_bin);
 
-                // accumulate FFT samples in the new mapped bin
-                _fft_bin[mapped_bin] += _v_real[curr_bin];
-            }
-            // if (_PERCEPTUAL_BINNING) {                     // this is too slow!
-            //   if (i == 0) _fft_bin[i] += _v_real[i];
-            //   else {
-            //     for (int j=0; j < NUM_AUDIO_BANDS; j++) {
-            //       if (i>int(round(low_bins[j])) && i<=int(round(high_bins[j]))) _fft_bin[j]  += _v_real[i];
-            //     }
-            //   }
-            // if (_PERCEPTUAL_BINNING) {
-            //   _fft_bin[i] += _v_real[int(round(center_bins[i]))];
-        } else {
-            _fft_bin[i] = _v_real[i];
-        }
-    }
-    if (_PERCEPTUAL_BINNING) {
         // Since not all bins will get data, fill the bins that are still zero with an avg of the neighboring bins
         // Note that this creates FFT energy where there was none previously.
         for (int i = 1; i < FFT_SAMPLES / 2 - 1; i++) {
@@ -362,107 +452,76 @@ void AudioProcessor::_postprocess_fft() {
                 _fft_bin[i] = int(double(_fft_bin[i - 1] + _fft_bin[i + 1]) / 2);
             }
         }
+    } else {
+        memcpy(_fft_bin, _v_real, sizeof(_fft_bin));
     }
 }
 
-// This method needs more work -- it is intended to track specific FFT bins (e.g. bass) and
-// detect peaks; however, it currently is too erratic to be used for visualizations.
+// Detects onsets and tracks the tempo, only trusting onsets when the volume is loud enough
 void AudioProcessor::_detect_beat() {
-    for (int i = 0; i < FFTS_PER_SEC - 1; i++) {
-        _bass_arr[i] = _bass_arr[i + 1];  // shift elements forward
-    }
-    _bass_arr[FFTS_PER_SEC - 1] = 0;  // reset last element
-
-    double curr_bass = 0.0;
-    for (int i = _lowest_bass_bin; i <= _highest_bass_bin; i++) {  // up to and including the highest bin
-        // accumulate the bass from the clean (e.g. not perceptually-binned) FFT
-        curr_bass += (_v_real[i]);
-    }
-    curr_bass /= (_highest_bass_bin - _lowest_bass_bin + 1);  // average the bass bins (note we went up to and including the highest bin so add 1 here)
-    _bass_arr[FFTS_PER_SEC - 1] = curr_bass;
-
-    double bass_sum = 0.0;
-    double bass_max = 0.0;
-    for (int i = 0; i < FFTS_PER_SEC; i++) {
-        bass_sum += _bass_arr[i];  // compute the sum of the history
-        if (_bass_arr[i] > bass_max) {
-            bass_max = _bass_arr[i];
-        }
-    }
-    _avg_bass = bass_sum / FFTS_PER_SEC;  // compute the avg
-
-    double bass_minus_avg_sq_sum = 0.0;
-    for (int i = 0; i < FFTS_PER_SEC; i++) {
-        bass_minus_avg_sq_sum += ((_bass_arr[i] - _avg_bass) * (_bass_arr[i] - _avg_bass));
-    }
-    _var_bass = bass_minus_avg_sq_sum / FFTS_PER_SEC;  // compute the var
-
-    // double _thresh_bass = (-15 * _var_bass + 1.55) * _avg_bass;
-    // double _thresh_bass = (bass_max - _avg_bass) * 0.5 + _avg_bass;
-    double _thresh_bass = _avg_bass + 3 * sqrt(_var_bass);
-
-    // must be loud enough, over thresh, and not too soon after the latest beat
-    if (curr_bass > _thresh_bass && (20 * log10(_curr_volume)) > VOL_THRESH_DB && (millis() - _last_beat_ms) > 200) {
-        _beat_detected = true;
-        _last_beat_ms = millis();
-    } else {
-        _beat_detected = false;
-    }
-
-    // Serial.print(String(20*log10(curr_volume)) + "," + String(20*log10(avg_volume)) + "," + String(curr_bass) + "," + String(_avg_bass) + "," + String(_thresh_bass) + "," + String(curr_bass / bass_max) + "\n");
+    bool trusted = _curr_volume > VOL_THRESH;
+    _beat_detector->process(_v_real, trusted);
 }
 
 // Calculates intensity for LEDs based on FFT, scaling brightness with the FFT magnitude and applying a smoothing parameter over time.
 void AudioProcessor::calc_intensity(int length) {
-    _interpolate_fft(FFT_SAMPLES / 2, length);  // interpolate the FFT to the length of LEDs we want to illuminate
+    if (_filterbank_scale != FILTERBANK_NONE) {
+        _apply_filterbank(length);  // filter the FFT down to the length of LEDs we want to illuminate
+    } else {
+        _interpolate_fft(FFT_SAMPLES / 2, length);  // interpolate the FFT to the length of LEDs we want to illuminate
+    }
+
+    bool trusted = _avg_volume > VOL_THRESH;  // only update if our volume is loud enough that we trust the data
 
     for (int i = 0; i < length; i++) {
-        if (_fft_interp[i] < 0) {
-            _fft_interp[i] = 0;
-        }
-        double constrain_val = constrain(_fft_interp[i], 0, 1);  // cap the range at [0 1]
-        double pow_val = pow(constrain_val, FFT_SCALE_POWER);    // raise to the power to increase sensitivity, multiply by max value to increase resolution
-        int map_val = int(round(pow_val * BRIGHT_LEVELS));  // scale this into discrete LED brightness levels
+        float val = _fft_interp[i];
+        int index = (val > 0) ? int(min(val, 1.0f) * (INTENSITY_LUT_SIZE - 1) + 0.5f) : 0;  // cap the range at [0 1], also catching NaN
+        int map_val = _intensity_lut[index];                                                 // look up the brightness level
 
-        _intensity[i] -= FADE;  // fade first
-        if (_intensity[i] < 0) _intensity[i] = 0;
+        int last = _intensity[i];
+        int curr = max(last - FADE, 0);  // fade first
 
-        if ((map_val >= _intensity[i]) && (20 * log10(_avg_volume) > VOL_THRESH_DB) && (map_val >= MIN_BRIGHT_UPDATE)) {  // if the FFT value is brighter AND our volume is loud enough that we trust the data AND it is brighter than our min thresh, update
-            _intensity[i] = map_val;
-            _intensity[i] = _last_intensity[i] * (1 - LED_SMOOTHING) + _intensity[i] * (LED_SMOOTHING);  // apply a smoothing parameter
+        if (trusted && (map_val >= curr) && (map_val >= MIN_BRIGHT_UPDATE)) {  // if the FFT value is brighter AND it is brighter than our min thresh, update
+            curr = (last * (256 - LED_SMOOTHING_Q8) + map_val * LED_SMOOTHING_Q8) >> 8;  // apply a smoothing parameter
         }
-        if (_intensity[i] < MIN_BRIGHT_FADE) {  // if less than the min value, floor to zero to reduce flicker
-            _intensity[i] = 0;
+        if (curr < MIN_BRIGHT_FADE) {  // if less than the min value, floor to zero to reduce flicker
+            curr = 0;
         }
 
-        _last_intensity[i] = _intensity[i];  // update the previous intensity value
+        _intensity[i] = curr;
     }
 }
 
 // Simple version that does no scaling or fading, and provides an intensity value for each column in the grid.
 void AudioProcessor::calc_intensity_simple() {
-    _clear_fft_bin();
+    if (_filterbank_scale != FILTERBANK_NONE) {
+        _apply_filterbank(GRID_W);  // filter the FFT directly to the number of columns
+    } else {
+        _clear_fft_bin();
 
-    // bin down using the audio bands
-    for (int i = 0; i < FFT_SAMPLES / 2; i++) {
-        if (i == 0)
-            _fft_bin[i] += _v_real[i];
-        else {
-            for (int j = 0; j < NUM_AUDIO_BANDS; j++) {
-                if (i > int(round(_low_bins[j])) && i <= int(round(_high_bins[j]))) _fft_bin[j] += _v_real[i];
-            }
-        }
-    }
+        // bin down using the audio bands
+        _apply_bin_ranges(_band_ranges, _num_band_ranges, _fft_bin);
 
-    // interpolate back up to the length desired.
-    _interpolate_fft(NUM_AUDIO_BANDS, GRID_W);
+        // interpolate back up to the length desired.
+        _interpolate_fft(NUM_AUDIO_BANDS, GRID_W);
+    }
 
     for (int i = 0; i < GRID_W; i++) {
-        _intensity[i] = int(round(_fft_interp[i] * 16));                                             // TODO: 4 is a fudge factor here to prevent values from peaking
-        _intensity[i] = _last_intensity[i] * (1 - LED_SMOOTHING) + _intensity[i] * (LED_SMOOTHING);  // apply a smoothing parameter
+        int map_val = int(round(_fft_interp[i] * 16));                                                 // TODO: 4 is a fudge factor here to prevent values from peaking
+        _intensity[i] = (_intensity[i] * (256 - LED_SMOOTHING_Q8) + map_val * LED_SMOOTHING_Q8) >> 8;  // apply a smoothing parameter
+    }
+}
 
-        _last_intensity[i] = _intensity[i];
+void AudioProcessor::_apply_filterbank(int length) {
+    if (_filterbank == NULL || _filterbank->get_scale() != _filterbank_scale || _filterbank->get_num_filters() != length) {
+        delete _filterbank;
+
+        // The FFT results skip the DC term, so the first amplitude is at one bin width
+        double bin_width = double(I2S_SAMPLE_RATE) / FFT_SAMPLES;
+        _filterbank = new Filterbank(_filterbank_scale, length, FFT_SAMPLES / 2 - 1, bin_width, bin_width, LOWEST_FREQ_BAND, HIGHEST_FREQ_BAND);
     }
+
+    _filterbank->apply(_v_real, _fft_interp);
 }
 
 void AudioProcessor::print_double_array(double *arr, int len) {
@@ -477,20 +536,36 @@ int *AudioProcessor::get_intensity() {
     return _intensity;
 }
 
-double AudioProcessor::_calc_rms(float *arr, int len) {
-    double sum = 0;
+float *AudioProcessor::get_fft_amplitudes() {
+    return _v_real;
+}
 
-    for (int i = 0; i < len; i++) {
-        sum = sum + arr[i] * arr[i];
-    }
-    return sqrt(sum / len);
+double AudioProcessor::get_tempo() {
+    return _beat_detector->get_tempo();
+}
+
+double AudioProcessor::get_beat_phase() {
+    return _beat_detector->get_phase();
+}
+
+bool AudioProcessor::is_onset() {
+    return _beat_detector->is_onset();
+}
+
+// Calculates the rms of the DC-removed sample history from the running sums, normalized to the mic's full scale
+double AudioProcessor::_calc_rms() {
+    double mean = double(_history_sum) / FFT_SAMPLES;
+    double mean_sq = double(_history_sum_sq) / FFT_SAMPLES;
+    double variance = max(mean_sq - mean * mean, 0.0);
+
+    return sqrt(variance) / (1 << (I2S_MIC_BIT_DEPTH - 1));
 }
 
 // Calculate RMS accounting for max RMS
-double AudioProcessor::_calc_rms_scaled(float *arr, int len) {
+double AudioProcessor::_calc_rms_scaled() {
     double rms_scale_val = sqrt(2) / 2;
 
-    return constrain(_calc_rms(arr, len) / rms_scale_val, 0, 1);
+    return constrain(_calc_rms() / rms_scale_val, 0, 1);
 }
 
 // Clears out the fft_bin array as it accumulates stale values
@@ -498,74 +573,18 @@ void AudioProcessor::_clear_fft_bin() {
     memset(_fft_bin, 0, sizeof(_fft_bin));
 }
 
-// Takes an array of FFT values and interpolates it to a new length.
-// TODO: there is a lot of repeated code here, refactor it
+// Takes an array of FFT values and interpolates it to a new length. The resampling plan is only re-calculated
+// if the lengths have changed.
 void AudioProcessor::_interpolate_fft(int old_length, int new_length) {
     if (new_length > NUM_LEDS) {
         print("WARNING: trying to interpolate into _fft_interp array that is too small!\n");
+        return;
     }
 
-    // Three scenarios:
-    // 1) new_length > old_length --> linearly interpolate up to new_length
-    // 2) new_length == old_length --> do nothing!
-    // 3) new_length < old_length --> find smallest integer multiple that gets new_length*MULT > FFT_SAMPLES/2
-    //                                 interpolate up to new_length*MULT
-    //                                 moving avg down to new_length
-
-    double scaled_index, fractional_index, floor_val, next_val, interp_val;
-    int16_t floor_index;
-    double fft_upscale[int(ceil(double(old_length) / double(new_length))) * new_length];  // this is used temporarily when interpolating the fft array to enable us to downscale via simple averaging
-
-    // Case 1: straight interpolate up
-    if (new_length > old_length) {
-        for (int i = 0; i < new_length; i++) {
-            scaled_index = (i / double((new_length - 1))) * double(old_length - 1);  // find the index where we should be within the FFT bins
-            floor_index = uint16_t(floor(scaled_index));                             // take the integer part of the index
-            fractional_index = scaled_index - floor_index;                           // take the fractional part of the index
-            floor_val = _fft_bin[floor_index];                                       // take the FFT at the integer index
-            if ((floor_index + 1) < old_length) {                                    // find the FFT at the next index
-                next_val = _fft_bin[floor_index + 1];
-            } else {
-                next_val = _fft_bin[floor_index];
-            }
-
-            interp_val = double(floor_val) + double(next_val - floor_val) * fractional_index;  // linear interpolation between the indices
-            _fft_interp[i] = interp_val;
-        }
-        // Case 2: do nothing
-    } else if (new_length == old_length) {
-        for (int i = 0; i < new_length; i++) {
-            _fft_interp[i] = _fft_bin[i];
-        }
-        // Case 3: interpolate up then average to decimate down
-    } else if (new_length < old_length) {
-        int multiple = ceil(double(old_length) / double(new_length));  // 2
-        int upscale_len = multiple * new_length;                       // 168
-        // upscale to 168
-        for (int i = 0; i < upscale_len; i++) {
-            scaled_index = (i / double((upscale_len - 1))) * double(old_length - 1);  // find the index where we should be within the FFT bins
-            floor_index = uint16_t(floor(scaled_index));                              // take the integer part of the index
-            fractional_index = scaled_index - floor_index;                            // take the fractional part of the index
-            floor_val = _fft_bin[floor_index];                                        // take the FFT at the integer index
-            if ((floor_index + 1) < old_length) {                                     // find the FFT at the next index
-                next_val = _fft_bin[floor_index + 1];
-            } else {
-                next_val = _fft_bin[floor_index];
-            }
-
-            interp_val = double(floor_val) + double(next_val - floor_val) * fractional_index;  // linear interpolation between the indices
-            fft_upscale[i] = interp_val;
-        }
-
-        // downscale with moving average
-        for (int i = 0; i < new_length; i++) {
-            interp_val = 0;
-            for (int j = 0; j < multiple; j++) {
-                interp_val += double(fft_upscale[i * multiple + j]) / double(multiple);
-            }
-            _fft_interp[i] = interp_val;
-        }
-    } else {
-        print("ERROR: interpolate_fft() failed, should not have gotten here\n");
+    if (_resampler == NULL || _resampler->get_old_length() != old_length || _resampler->get_new_length() != new_length) {
+        delete _resampler;
+        _resampler = new Resampler(old_length, new_length);
     }
+
+    _resampler->apply(_fft_bin, _fft_interp);
 }
@@ -2,14 +2,29 @@
 #define _AUDIOPROCESSOR_H
 
 #include <Arduino.h>
-#include <driver/i2s.h>
-#include <soc/i2c_reg.h>
 
+#include "AudioSource.h"
+#include "BeatDetector.h"
 #include "Constants.h"
+#include "FFTWindow.h"
+#include "Filterbank.h"
+#include "Resampler.h"
+#include "FixedFFT.h"
 #include "fft.h"
 
+// A run of consecutive FFT bins that is summed into a single output bin. The first and last bins of the run are
+// weighted so that bins straddling the edge between two outputs can be split between them.
+struct bin_range_t {
+    uint16_t out;        // output bin index
+    uint16_t start;      // first FFT bin in the run
+    uint16_t end;        // last FFT bin in the run (inclusive)
+    float start_weight;  // weight of the first bin (the whole bin if start == end)
+    float end_weight;    // weight of the last bin (unused if start == end)
+};
+
 // The AudioProcessor class is meant to be instantiated once, and encapsulates the interactions with the microphone 
-// for audio capture as well as the implementation of the FFT and subsequent post-processing.
+// for audio capture as well as the implementation of the FFT and subsequent post-processing. Audio samples are
+// pulled from an AudioSource (see AudioSource.h), which defaults to the I2S microphone.
 class AudioProcessor {
    public:
     // Constructor to be called with flags defining post-FFT processing options as follows:
@@ -19,20 +34,30 @@ class AudioProcessor {
     //          (see: https://en.wikipedia.org/wiki/A-weighting)
     //      perceptual_binning: applies a gamma curve to re-bin the FFT results to match human perception
     //      volume_scaling: normalizes the FFT output by the current volume
-    AudioProcessor(bool white_noise_eq, bool a_weighting_eq, bool perceptual_binning, bool volume_scaling);
+    //      source: optional pointer to the AudioSource to read samples from. If NULL, an I2SAudioSource is
+    //          created and owned by the AudioProcessor.
+    AudioProcessor(bool white_noise_eq, bool a_weighting_eq, bool perceptual_binning, bool volume_scaling, AudioSource *source = NULL);
     ~AudioProcessor();
 
-    // Collects audio samples from I2S bus. Each call collects the next FFT_SAMPLES (defined in Constants.h).
+    // Collects audio samples from the audio source. Each call collects the next FFT_SAMPLES (defined in Constants.h).
     // Because each call fills the buffer independently, the FFT results may be erratic.
     // Use get_audio_samples_gapless() instead for smoother FFT results.
     void get_audio_samples();
 
-    // Collects audio samples from I2S bus. Each call collects the next FFT_SAMPLES/2 samples (defined in 
-    // Constants.h). Each call shifts the existing back *half* of the buffer forward, and fills new samples 
-    // in the back half of the buffer. This creates a 50% overlap between successive FFT calls, giving
-    // smoother results.
+    // Collects audio samples from the audio source. Each call collects the next FFT_HOP_SAMPLES samples (defined in
+    // Constants.h) into a circular sample history, overwriting the oldest samples. Each FFT runs over the full
+    // history, so successive FFTs overlap by FFT_SAMPLES - FFT_HOP_SAMPLES samples, giving smoother results and
+    // a higher update rate without increasing the FFT size.
     void get_audio_samples_gapless();
 
+    // Sets the window applied to the audio samples before each FFT. Defaults to FFT_WINDOW (defined in Constants.h).
+    void set_window(FFTWindowType type);
+
+    // Sets the filterbank used by calc_intensity() and calc_intensity_simple(). With FILTERBANK_NONE they use
+    // perceptual binning or the log-spaced audio bands respectively, and interpolate to the output length.
+    // Otherwise the filterbank outputs directly at the requested length.
+    void set_filterbank(FilterbankScale scale);
+
     // Updates the internal volume variable using the most recent audio samples.
     void update_volume();
 
@@ -50,12 +75,25 @@ class AudioProcessor {
     // Constants.h.
     void calc_intensity_simple();
 
+    // Returns the tempo of the music in beats per minute, or 0 if it could not be found.
+    double get_tempo();
+
+    // Returns the position within the current beat, from 0 (on the beat) up to 1.
+    double get_beat_phase();
+
+    // Returns true if an onset (e.g. a drum hit) was detected in the latest FFT.
+    bool is_onset();
+
     // Helper function that prints array values to serial port.
     void print_double_array(double *arr, int len);
 
     // Returns a pointer to the LED intensity array.
     int *get_intensity();
 
+    // Returns a pointer to the post-processed FFT amplitudes from the last run_fft(). The DC term is skipped, so
+    // there are FFT_SAMPLES / 2 - 1 amplitudes.
+    float *get_fft_amplitudes();
+
     // Returns true if the AudioProcessor initialization succeeded
     bool is_active();
 
@@ -65,20 +103,41 @@ class AudioProcessor {
     // Initializes all private variables.
     void _init_variables();
 
-    // Initializes I2S driver in the ESP32.
-    bool _i2s_init();
+    // Reads samples_to_read samples from the audio source into buffer, returning the number actually read.
+    int _read_samples(int32_t *buffer, int samples_to_read);
+
+    // Reads samples_to_read new samples into the sample history and updates its running sums.
+    void _push_samples(int samples_to_read);
+
+    // Copies the sample history into the FFT input, removing the DC offset, applying the window and scaling as needed.
+    void _load_fft_input();
 
-    // Sets up audio bins for use with calc_intensity_simple.
+    // Sets up audio bins for use with calc_intensity_simple, and the bin ranges used for audio bands and perceptual
+    // binning.
     void _setup_audio_bins();
 
+    // Sets up the bin ranges that map FFT bins to the perceptual bins defined by GAMMA16_FFT (in Constants.h).
+    void _setup_perceptual_bins();
+
+    // Sums the FFT results over each bin range, adding each sum to the range's output bin in out.
+    void _apply_bin_ranges(const bin_range_t *ranges, int num_ranges, float *out);
+
     // Sets fft_bin array to zeros.
     void _clear_fft_bin();
 
-    // Calculates rms value for a given array.
-    double _calc_rms(float *arr, int len);
+    // Calculates rms value of the sample history, normalized to the mic's full scale.
+    double _calc_rms();
 
     // Calculates rms value scaled by sqrt(2) / 2.
-    double _calc_rms_scaled(float *arr, int len);
+    double _calc_rms_scaled();
+
+    // Fills the lookup table that maps FFT magnitudes to LED brightness levels.
+    void _init_intensity_table();
+
+#ifdef FFT_FIXED_POINT
+    // Converts the FFT_REMOVE and FFT_EQ tables (see Constants.h) to fixed-point.
+    void _init_fixed_point_tables();
+#endif
 
     // Performs FFT on audio samples.
     void _perform_fft();
@@ -86,29 +145,48 @@ class AudioProcessor {
     // Postprocesses the FFT results to remove noise and apply weighting/binning as set during initialization.
     void _postprocess_fft();
 
+    // Applies the current filterbank to the FFT results, storing length outputs in _fft_interp. The filterbank
+    // weights are only re-calculated if the scale or length has changed.
+    void _apply_filterbank(int length);
+
     // Interpolates FFT results to a new array size.
     void _interpolate_fft(int old_length, int new_length);
 
-    // Detects a beat based on  audio samples.
+    // Runs onset detection and tempo tracking on the FFT results.
     void _detect_beat();
 
     bool _is_active = false;
 
+    AudioSource *_source;        // source of raw audio samples
+    bool _owns_source = false;   // true if the source was created by (and should be deleted with) this object
+
+    // Variables for audio sample history
+    int32_t _history[FFT_SAMPLES] = {0};  // circular buffer holding the last FFT_SAMPLES bit-shifted audio samples
+    int _history_pos = 0;                 // index of the oldest sample, which is where the next new sample is written
+    int64_t _history_sum = 0;             // running sum of the history, for DC removal
+    int64_t _history_sum_sq = 0;          // running sum of the squared history, for volume
+
     // Variables for FFT
+    const FFTWindowTable<FFT_SAMPLES> *_window;  // window applied to the samples before the FFT (stored in flash)
+#ifdef FFT_FIXED_POINT
+    FixedFFT *_fixed_fft;
+    int32_t _q_amplitudes[FFT_SAMPLES] = {0};      // stores scaled FFT input, then replaced by FFT amplitudes (FFT_SAMPLES / 2 length)
+    int32_t _q_fft_remove[FFT_SAMPLES / 2] = {0};  // FFT_REMOVE in units of 1 << FIXED_FFT_INPUT_BITS
+    uint16_t _q_fft_eq[FFT_SAMPLES / 2] = {0};     // white noise eq gain in Q8
+    float _v_real[FFT_SAMPLES / 2] = {0.0};        // stores post-processed FFT data
+#else
     fft_config_t *_real_fft_plan;
-    float _v_real[FFT_SAMPLES] = {0.0};        // stores audio samples, then replaced by FFT real data (up to FFT_SAMPLES / 2 length)
+    float _v_real[FFT_SAMPLES] = {0.0};        // stores scaled audio samples, then replaced by FFT real data (up to FFT_SAMPLES / 2 length)
     float _v_imag[FFT_SAMPLES] = {0.0};        // stores all zeros prior to FFT, then replaced by FFT imaginary data (up to FFT_SAMPLES / 2 length)
-    double _fft_bin[FFT_SAMPLES / 2] = {0.0};  // stores perceptually binned FFT data
-    double _fft_interp[NUM_LEDS] = {0.0};      // stores interpolated FFT data (up to user-specified length)
+#endif
+    float _fft_bin[FFT_SAMPLES / 2] = {0.0};   // stores perceptually binned FFT data
+    float _fft_interp[NUM_LEDS] = {0.0};       // stores interpolated FFT data (up to user-specified length)
+    FilterbankScale _filterbank_scale = FILTERBANK_NONE;
+    Filterbank *_filterbank = NULL;            // filterbank for the current scale and output length
+    Resampler *_resampler = NULL;              // resampling plan for the current interpolation lengths
 
     // Variables for beat detection
-    int _lowest_bass_bin = 0;
-    int _highest_bass_bin = 0;
-    double _avg_bass = 0.0;
-    double _var_bass = 0.0;
-    double _bass_arr[FFTS_PER_SEC] = {0.0};
-    unsigned long _last_beat_ms = 0;
-    bool _beat_detected = false;
+    BeatDetector *_beat_detector;
 
     // FFT post-processing options
     bool _WHITE_NOISE_EQ = true;
@@ -116,14 +194,12 @@ class AudioProcessor {
     bool _PERCEPTUAL_BINNING = true;
     bool _VOLUME_SCALING = true;
 
-    // Variables for LEDs
-    int _last_intensity[NUM_LEDS]{0};  // holds the last frame intensities for smoothing
-
     // Other variables
     double _max_fft_val = 0;  // used to normalize the FFT outputs to [0 1]
 
     // Variables for LEDs
-    int _intensity[NUM_LEDS] = {0};  // holds the brightness values for LEDs
+    int _intensity[NUM_LEDS] = {0};  // holds the brightness values for LEDs, which are also the last frame's values for smoothing
+    uint8_t _intensity_lut[INTENSITY_LUT_SIZE] = {0};  // LED brightness level for each quantized FFT magnitude in [0 1]
 
     // Variables for volume
     double _curr_volume = 0;      // stores instantaneous volume
@@ -135,6 +211,10 @@ class AudioProcessor {
     float _bin_freqs[NUM_AUDIO_BANDS] = {0};
     float _low_bins[NUM_AUDIO_BANDS] = {0};
     float _high_bins[NUM_AUDIO_BANDS] = {0};
+    bin_range_t _band_ranges[NUM_AUDIO_BANDS];            // FFT bins summed into each audio band
+    int _num_band_ranges = 0;                             // number of audio bands that contain at least one FFT bin
+    bin_range_t _perceptual_ranges[FFT_SAMPLES / 4];      // FFT bins summed into each perceptual bin
+    int _num_perceptual_ranges = 0;
 
     bool _audio_first_loop = true;  // tracks first iteration through audio loop
 };
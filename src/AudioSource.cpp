@@ -0,0 +1,264 @@
+#include "AudioSource.h"
+
+#include "Utils.h"
+
+AudioSource::~AudioSource() {
+}
+
+// Initialize I2S for audio ADC
+bool I2SAudioSource::init() {
+    i2s_config_t i2s_config = {
+        .mode = i2s_mode_t(I2S_MODE_MASTER | I2S_MODE_RX),
+        .sample_rate = I2S_SAMPLE_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,  // I2S mic transfer only works with 32b
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = i2s_comm_format_t(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB),
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = 4,
+        .dma_buf_len = FFT_SAMPLES,
+        .use_apll = false,
+        .tx_desc_auto_clear = false,
+        .fixed_mclk = 0};
+
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = PIN_I2S_BCK,          // Serial Clock (SCK)
+        .ws_io_num = PIN_I2S_WS,            // Word Select (WS)
+        .data_out_num = I2S_PIN_NO_CHANGE,  // not used (only for speakers)
+        .data_in_num = PIN_I2S_DIN          // Serial Data (SD)
+    };
+
+    // Workaround for SPH0645 timing issue (see comments: https://hackaday.io/project/162059-street-sense/log/160705-new-i2s-microphone)
+    REG_SET_BIT(I2S_TIMING_REG(I2S_PORT), BIT(9));
+    REG_SET_BIT(I2S_CONF_REG(I2S_PORT), I2S_RX_MSB_SHIFT);
+
+    if (i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL) != ESP_OK) {
+        print("Audio Error (i2s_driver_install): Check that microphone is connected to Audio In port\n");
+        return false;
+    }
+    if (i2s_set_pin(I2S_PORT, &pin_config) != ESP_OK) {
+        print("Audio Error (i2s_set_pin): Check that microphone is connected to Audio In port\n");
+        return false;
+    }
+
+    print("Audio I2S init complete\n");
+    return true;
+}
+
+// Read samples from the I2S mic, blocking until the requested number of samples is available
+int I2SAudioSource::read(int32_t *buffer, int num_samples) {
+    size_t bytes_read = 0;
+
+    // First audio samples are junk, so prime the system then delay
+    if (!_primed) {
+        i2s_read(I2S_PORT, (void *)buffer, num_samples * sizeof(buffer[0]), &bytes_read, portMAX_DELAY);  // no timeout
+        delay(1000);
+        _primed = true;
+    }
+    i2s_read(I2S_PORT, (void *)buffer, num_samples * sizeof(buffer[0]), &bytes_read, portMAX_DELAY);  // no timeout
+
+    return int(bytes_read / sizeof(buffer[0]));  // since a sample is 32 bits (4 bytes)
+}
+
+// Constructor to define the synthetic tone
+ToneAudioSource::ToneAudioSource(double freq_hz, double amplitude, double noise, bool realtime) {
+    _phase_step = 2 * PI * freq_hz / I2S_SAMPLE_RATE;
+    _amplitude = amplitude;
+    _noise = noise;
+    _realtime = realtime;
+}
+
+bool ToneAudioSource::init() {
+    _phase = 0.0;
+    _next_us = micros();
+
+    print("Audio tone source init complete\n");
+    return true;
+}
+
+// Generate the next block of samples in the same left-justified format as the I2S mic
+int ToneAudioSource::read(int32_t *buffer, int num_samples) {
+    // Full scale for the mic bit depth, left-justified in a 32-bit container
+    double full_scale = double((1 << (I2S_MIC_BIT_DEPTH - 1)) - 1) * (1 << (32 - I2S_MIC_BIT_DEPTH));
+
+    for (int i = 0; i < num_samples; i++) {
+        double val = _amplitude * sin(_phase);
+        if (_noise > 0) {
+            val += _noise * (double(random(-32768, 32768)) / 32768);
+        }
+        val = constrain(val, -1.0, 1.0);
+
+        buffer[i] = int32_t(round(val * full_scale));
+
+        _phase += _phase_step;
+        if (_phase >= 2 * PI) {
+            _phase -= 2 * PI;
+        }
+    }
+
+    // Mimic the blocking behavior of the I2S driver by waiting until the samples would have been captured
+    if (_realtime) {
+        _next_us += (unsigned long)(double(num_samples) / I2S_SAMPLE_RATE * 1e6);
+        long wait_us = long(_next_us - micros());
+        if (wait_us > 0) {
+            delayMicroseconds(wait_us);
+        } else {
+            _next_us = micros();  // we fell behind, so don't try to catch up
+        }
+    }
+
+    return num_samples;
+}
+
+// Constructor to define the WAV file to play back
+WavAudioSource::WavAudioSource(const char *path, bool loop, bool realtime) {
+    _path = path;
+    _loop = loop;
+    _realtime = realtime;
+}
+
+WavAudioSource::~WavAudioSource() {
+    if (_file != NULL) {
+        fclose(_file);
+    }
+}
+
+// Reads a little-endian integer of num_bytes bytes
+static uint32_t read_le(const uint8_t *bytes, int num_bytes) {
+    uint32_t val = 0;
+    for (int i = num_bytes - 1; i >= 0; i--) {
+        val = (val << 8) | bytes[i];
+    }
+    return val;
+}
+
+// Open the file and parse the WAV header, leaving the file at the first sample
+bool WavAudioSource::init() {
+    if (_file != NULL) {
+        fclose(_file);
+    }
+    _file = fopen(_path, "rb");
+    if (_file == NULL) {
+        print("Audio Error: could not open %s\n", _path);
+        return false;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), _file) != sizeof(header) || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        print("Audio Error: %s is not a WAV file\n", _path);
+        return false;
+    }
+
+    // Walk the chunks until we find the data, which must come after the format
+    uint16_t format = 0, channels = 0, bits_per_sample = 0;
+    uint32_t sample_rate = 0;
+    while (true) {
+        uint8_t chunk_header[8];
+        if (fread(chunk_header, 1, sizeof(chunk_header), _file) != sizeof(chunk_header)) {
+            print("Audio Error: no audio data in %s\n", _path);
+            return false;
+        }
+        uint32_t chunk_size = read_le(chunk_header + 4, 4);
+
+        if (memcmp(chunk_header, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (chunk_size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), _file) != sizeof(fmt)) {
+                print("Audio Error: bad format chunk in %s\n", _path);
+                return false;
+            }
+            format = read_le(fmt, 2);
+            channels = read_le(fmt + 2, 2);
+            sample_rate = read_le(fmt + 4, 4);
+            bits_per_sample = read_le(fmt + 14, 2);
+            chunk_size -= sizeof(fmt);
+        } else if (memcmp(chunk_header, "data", 4) == 0) {
+            if (channels == 0) {
+                print("Audio Error: no format chunk before the audio data in %s\n", _path);
+                return false;
+            }
+            _data_start = ftell(_file);
+            _length = chunk_size / (channels * (bits_per_sample / 8));
+            break;
+        }
+
+        fseek(_file, chunk_size + (chunk_size & 1), SEEK_CUR);  // chunks are padded to an even size
+    }
+
+    // 0xFFFE is WAVE_FORMAT_EXTENSIBLE, which 24 and 32-bit PCM recordings are often saved as
+    if ((format != 1 && format != 0xFFFE) || (bits_per_sample != 16 && bits_per_sample != 24 && bits_per_sample != 32)) {
+        print("Audio Error: %s must be 16, 24 or 32-bit PCM\n", _path);
+        return false;
+    }
+    if (sample_rate != I2S_SAMPLE_RATE) {
+        print("Audio Error: %s is sampled at %d Hz, expected %d Hz\n", _path, sample_rate, I2S_SAMPLE_RATE);
+        return false;
+    }
+
+    _bytes_per_sample = bits_per_sample / 8;
+    _frame_bytes = channels * _bytes_per_sample;
+    _pos = 0;
+    _next_us = micros();
+
+    print("Audio WAV source init complete (%s, %.1f sec)\n", _path, double(_length) / I2S_SAMPLE_RATE);
+    return true;
+}
+
+int WavAudioSource::_read_file(int32_t *buffer, int num_samples) {
+    uint8_t raw[256 * 4 * 2];  // room for 256 frames of two 32-bit channels
+    int max_frames = sizeof(raw) / _frame_bytes;
+    int samples_read = 0;
+
+    while (samples_read < num_samples && _pos < _length) {
+        int frames = min(min(num_samples - samples_read, max_frames), int(_length - _pos));
+        frames = fread(raw, _frame_bytes, frames, _file);
+        if (frames == 0) {
+            _length = _pos;  // the file is shorter than its header claims
+            break;
+        }
+
+        // Left-justify the first channel in a 32-bit word, as the I2S mic does. Bits below I2S_MIC_BIT_DEPTH are
+        // shifted out by the AudioProcessor.
+        for (int i = 0; i < frames; i++) {
+            uint32_t val = read_le(raw + i * _frame_bytes, _bytes_per_sample);
+            buffer[samples_read + i] = int32_t(val << (32 - 8 * _bytes_per_sample));
+        }
+        samples_read += frames;
+        _pos += frames;
+    }
+
+    return samples_read;
+}
+
+// Read the next block of samples, restarting at the beginning of the file if looping
+int WavAudioSource::read(int32_t *buffer, int num_samples) {
+    if (_file == NULL) {
+        return 0;
+    }
+
+    int samples_read = _read_file(buffer, num_samples);
+    while (_loop && samples_read < num_samples && _length > 0) {
+        fseek(_file, _data_start, SEEK_SET);
+        _pos = 0;
+        samples_read += _read_file(buffer + samples_read, num_samples - samples_read);
+    }
+
+    // Mimic the blocking behavior of the I2S driver by waiting until the samples would have been captured
+    if (_realtime) {
+        _next_us += (unsigned long)(double(samples_read) / I2S_SAMPLE_RATE * 1e6);
+        long wait_us = long(_next_us - micros());
+        if (wait_us > 0) {
+            delayMicroseconds(wait_us);
+        } else {
+            _next_us = micros();  // we fell behind, so don't try to catch up
+        }
+    }
+
+    return samples_read;
+}
+
+bool WavAudioSource::finished() {
+    return !_loop && _pos >= _length;
+}
+
+uint32_t WavAudioSource::length() {
+    return _length;
+}
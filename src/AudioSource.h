@@ -0,0 +1,99 @@
+#ifndef _AUDIOSOURCE_H
+#define _AUDIOSOURCE_H
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include <soc/i2c_reg.h>
+
+#include "Constants.h"
+
+// The AudioSource class is an abstract class that supplies raw audio samples to the AudioProcessor.
+// Samples are always delivered as 32-bit words in the left-justified container format produced by
+// the I2S microphone, so the AudioProcessor can treat every source identically. Swapping the source
+// allows the FFT/post-processing/intensity pipeline to be exercised and profiled without a
+// microphone connected.
+class AudioSource {
+   public:
+    virtual ~AudioSource();
+
+    // Initializes the source. Returns true on success.
+    virtual bool init() = 0;
+
+    // Reads up to num_samples samples into buffer, blocking until they are available.
+    // Returns the number of samples actually read.
+    virtual int read(int32_t *buffer, int num_samples) = 0;
+};
+
+// Reads samples from an I2S microphone (SPH0645) using the ESP32's I2S peripheral.
+class I2SAudioSource : public AudioSource {
+   public:
+    bool init() override;
+    int read(int32_t *buffer, int num_samples) override;
+
+   private:
+    bool _primed = false;  // tracks if the junk samples at startup have been discarded
+};
+
+// Generates a synthetic sine tone, optionally with white noise added. Useful for exercising the
+// audio pipeline on a board without a microphone attached (see AUDIO_SOURCE_TONE in Constants.h).
+// Arguments:
+//      freq_hz: frequency of the tone
+//      amplitude: amplitude of the tone, in the range [0 1] relative to full scale
+//      noise: amplitude of the added white noise, in the range [0 1] relative to full scale
+//      realtime: if true, read() blocks for the duration of the samples it returns, similar to
+//          the I2S source. If false, read() returns immediately so the pipeline runs flat out.
+class ToneAudioSource : public AudioSource {
+   public:
+    ToneAudioSource(double freq_hz, double amplitude, double noise = 0.0, bool realtime = true);
+
+    bool init() override;
+    int read(int32_t *buffer, int num_samples) override;
+
+   private:
+    double _phase = 0.0;       // current phase of the tone, in radians
+    double _phase_step;        // phase increment per sample, in radians
+    double _amplitude;
+    double _noise;
+    bool _realtime;
+    unsigned long _next_us = 0;  // time at which the next block of samples is "available"
+};
+
+// Plays back a PCM WAV file (16, 24 or 32-bit), e.g. a recording made with the microphone, so that the pipeline can
+// be run and benchmarked on the same audio every time. Only the first channel is used, like the I2S mic, and the file
+// must be sampled at I2S_SAMPLE_RATE. The path is passed to fopen(), so on the ESP32 it should include the mount
+// point of the filesystem (e.g. "/spiffs/track.wav").
+// Arguments:
+//      path: path to the WAV file
+//      loop: if true, playback restarts at the end of the file. If false, read() returns 0 once it is done.
+//      realtime: see ToneAudioSource
+class WavAudioSource : public AudioSource {
+   public:
+    WavAudioSource(const char *path, bool loop = true, bool realtime = true);
+    ~WavAudioSource();
+
+    bool init() override;
+    int read(int32_t *buffer, int num_samples) override;
+
+    // Returns true once a non-looping source has played the whole file.
+    bool finished();
+
+    // Returns the length of the file in samples (per channel).
+    uint32_t length();
+
+   private:
+    // Reads the next samples from the file, converting them to the I2S mic format. Returns the number read.
+    int _read_file(int32_t *buffer, int num_samples);
+
+    const char *_path;
+    bool _loop;
+    bool _realtime;
+    FILE *_file = NULL;
+    long _data_start = 0;        // file offset of the first sample
+    uint32_t _length = 0;        // number of samples (per channel) in the file
+    uint32_t _pos = 0;           // index of the next sample to read
+    uint16_t _bytes_per_sample = 0;
+    uint16_t _frame_bytes = 0;   // bytes per sample across all channels
+    unsigned long _next_us = 0;  // time at which the next block of samples is "available"
+};
+
+#endif  // _AUDIOSOURCE_H
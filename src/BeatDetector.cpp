@@ -0,0 +1,173 @@
+#include "BeatDetector.h"
+
+// The flux history must hold two of the longest beat periods, and _autocorr one lag past the longest period
+static_assert(BEAT_FLUX_HISTORY / 2 - 2 >= BEAT_MAX_PERIOD_FRAMES, "BEAT_FLUX_HISTORY is too short for BEAT_MIN_BPM");
+static_assert((BEAT_FLUX_HISTORY & (BEAT_FLUX_HISTORY - 1)) == 0, "BEAT_FLUX_HISTORY must be a power of 2");
+
+// Constructor, sets up the flux bands and tempo search range
+BeatDetector::BeatDetector(int num_bins, double first_bin_freq, double bin_width, double frames_per_sec) {
+    _num_bins = min(num_bins, FFT_SAMPLES / 2);
+    _frames_per_sec = frames_per_sec;
+
+    for (int b = 0; b < int(BEAT_NUM_BANDS); b++) {
+        _band_start[b] = constrain(int(ceil((BEAT_BAND_EDGES_HZ[b] - first_bin_freq) / bin_width)), 0, _num_bins);
+        _band_end[b] = constrain(int(ceil((BEAT_BAND_EDGES_HZ[b + 1] - first_bin_freq) / bin_width)), 0, _num_bins);
+    }
+
+    // Beat periods to search, in frames. The flux history must hold at least two periods, and _estimate_tempo()
+    // also needs the autocorrelation one lag either side of the range.
+    _min_lag = max(int(floor(60.0 * frames_per_sec / BEAT_MAX_BPM)), 1);
+    _max_lag = min(int(ceil(60.0 * frames_per_sec / BEAT_MIN_BPM)), BEAT_FLUX_HISTORY / 2 - 2);
+
+    // Log-Gaussian tempo prior, one octave wide
+    for (int lag = _min_lag; lag <= _max_lag; lag++) {
+        double octaves = log2(60.0 * frames_per_sec / lag / BEAT_PRIOR_BPM);
+        _lag_weights[lag] = exp(-0.5 * octaves * octaves);
+    }
+}
+
+void BeatDetector::process(const float *amplitudes, bool trusted) {
+    float flux = _calc_flux(amplitudes);
+
+    // Compare against the statistics of the previous frames
+    double mean = _thresh_sum / BEAT_THRESH_HISTORY;
+    double var = max(_thresh_sum_sq / BEAT_THRESH_HISTORY - mean * mean, 0.0);
+    double thresh = max(mean + BEAT_THRESH_STD * sqrt(var), mean * BEAT_THRESH_MIN_RATIO);
+
+    _frames_since_onset++;
+    _onset = trusted && (flux > thresh) && (_frames_since_onset * 1000.0 / _frames_per_sec >= BEAT_MIN_INTERVAL_MS);
+    if (_onset) {
+        _frames_since_onset = 0;
+    }
+
+    // Replace the oldest value in the threshold history, updating the running sums
+    float oldest = _thresh_history[_thresh_pos];
+    _thresh_sum += flux - oldest;
+    _thresh_sum_sq += double(flux) * flux - double(oldest) * oldest;
+    _thresh_history[_thresh_pos] = flux;
+    _thresh_pos = (_thresh_pos + 1) & (BEAT_THRESH_HISTORY - 1);
+
+    _flux_history[_flux_pos] = flux;
+    _flux_pos = (_flux_pos + 1) & (BEAT_FLUX_HISTORY - 1);
+
+    if (--_frames_until_tempo <= 0) {
+        _estimate_tempo();
+        _frames_until_tempo = BEAT_TEMPO_UPDATE_FRAMES;
+    }
+
+    _update_phase();
+}
+
+bool BeatDetector::is_onset() {
+    return _onset;
+}
+
+double BeatDetector::get_tempo() {
+    return _tempo;
+}
+
+double BeatDetector::get_phase() {
+    return _phase;
+}
+
+float BeatDetector::_calc_flux(const float *amplitudes) {
+    float total = 0;
+
+    for (int b = 0; b < int(BEAT_NUM_BANDS); b++) {
+        float band_flux = 0;
+        for (int i = _band_start[b]; i < _band_end[b]; i++) {
+            float diff = amplitudes[i] - _last_amplitudes[i];
+            if (diff > 0) {  // only increases in amplitude indicate an onset
+                band_flux += diff;
+            }
+        }
+
+        _avg_band_flux[b] += (band_flux - _avg_band_flux[b]) * BEAT_BAND_AVG_SCALE;
+        if (_avg_band_flux[b] > 0) {
+            total += band_flux / _avg_band_flux[b];
+        }
+    }
+    memcpy(_last_amplitudes, amplitudes, _num_bins * sizeof(amplitudes[0]));
+
+    return total;
+}
+
+void BeatDetector::_estimate_tempo() {
+    float mean = 0;
+    for (int i = 0; i < BEAT_FLUX_HISTORY; i++) {
+        mean += _flux_history[i];
+    }
+    mean /= BEAT_FLUX_HISTORY;
+
+    // Autocorrelation of the mean-removed flux history, in chronological order starting at the oldest value
+    auto autocorr = [&](int lag) {
+        float sum = 0;
+        for (int n = lag; n < BEAT_FLUX_HISTORY; n++) {
+            float x = _flux_history[(_flux_pos + n) & (BEAT_FLUX_HISTORY - 1)] - mean;
+            float x_lag = _flux_history[(_flux_pos + n - lag) & (BEAT_FLUX_HISTORY - 1)] - mean;
+            sum += x * x_lag;
+        }
+        return sum;
+    };
+
+    float energy = autocorr(0);
+    if (energy <= 0) {  // no signal
+        _tempo = 0;
+        return;
+    }
+
+    for (int lag = _min_lag - 1; lag <= _max_lag + 1; lag++) {
+        _autocorr[lag] = autocorr(lag);
+    }
+
+    // Beat periods are rarely a whole number of frames, so the energy of a period is split between neighboring
+    // lags. Smooth across neighbors so that multiples of the period don't win simply by being closer to whole.
+    int best_lag = 0;
+    float best_score = 0;
+    for (int lag = _min_lag; lag <= _max_lag; lag++) {
+        float smoothed = _autocorr[lag] + 0.5 * (_autocorr[lag - 1] + _autocorr[lag + 1]);
+        float score = smoothed * _lag_weights[lag];
+        if (score > best_score) {
+            best_score = score;
+            best_lag = lag;
+        }
+    }
+
+    if (best_lag == 0 || best_score / (2 * energy) < BEAT_MIN_CONFIDENCE) {  // no periodicity
+        _tempo = 0;
+        return;
+    }
+
+    // Refine the period with parabolic interpolation between the neighboring lags
+    double lag = best_lag;
+    float prev_corr = _autocorr[best_lag - 1];
+    float best_corr = _autocorr[best_lag];
+    float next_corr = _autocorr[best_lag + 1];
+    float denom = prev_corr - 2 * best_corr + next_corr;
+    if (denom < 0) {
+        lag += 0.5 * (prev_corr - next_corr) / denom;
+    }
+
+    double tempo = 60.0 * _frames_per_sec / lag;
+    if (_tempo > 0 && abs(tempo - _tempo) < 0.1 * _tempo) {
+        _tempo += (tempo - _tempo) * 0.25;  // small changes are smoothed
+    } else {
+        _tempo = tempo;  // large changes mean the tempo actually changed
+    }
+}
+
+void BeatDetector::_update_phase() {
+    if (_tempo <= 0) {
+        _phase = 0;
+        return;
+    }
+
+    _phase += _tempo / 60.0 / _frames_per_sec;
+
+    if (_onset) {  // pull the phase towards the onset, which should be on the beat
+        double error = (_phase < 0.5) ? _phase : _phase - 1;
+        _phase -= BEAT_PHASE_GAIN * error;
+    }
+
+    _phase -= floor(_phase);  // wrap to [0, 1)
+}
@@ -0,0 +1,83 @@
+#ifndef _BEATDETECTOR_H
+#define _BEATDETECTOR_H
+
+#include <Arduino.h>
+
+#include "Constants.h"
+
+#define BEAT_NUM_BANDS (ARRAY_SIZE(BEAT_BAND_EDGES_HZ) - 1)
+
+// The BeatDetector class detects note onsets and tracks the tempo and beat phase of music, given one set of
+// FFT amplitudes per frame.
+//
+// Onsets are detected with multi-band spectral flux: for each band, the sum of the increases in amplitude since
+// the last frame, normalized by a running average of that band's flux so that no one band dominates. An onset
+// is detected when the total flux exceeds an adaptive threshold of mean + BEAT_THRESH_STD standard deviations
+// (and at least BEAT_THRESH_MIN_RATIO times the mean) over recent frames, where the mean and variance are kept
+// as running sums over a ring buffer.
+//
+// The tempo is estimated periodically from the autocorrelation of the flux history, smoothed across
+// neighboring lags and weighted towards
+// BEAT_PRIOR_BPM to avoid half/double tempo errors. The beat phase advances at the estimated tempo, and is
+// pulled towards each detected onset like a phase-locked loop.
+class BeatDetector {
+   public:
+    // Constructor, accepts the number of FFT amplitudes that will be passed to process() (and the frequency of
+    // the first one), the width of each FFT bin in Hz, and the number of frames processed per second.
+    BeatDetector(int num_bins, double first_bin_freq, double bin_width, double frames_per_sec);
+
+    // Processes one frame of FFT amplitudes. Onsets are only detected if trusted is true (e.g. when the volume
+    // is loud enough that the FFT data is reliable).
+    void process(const float *amplitudes, bool trusted);
+
+    // Returns true if an onset was detected in the last processed frame.
+    bool is_onset();
+
+    // Returns the estimated tempo in beats per minute, or 0 if no tempo has been found.
+    double get_tempo();
+
+    // Returns the position within the current beat, from 0 (on the beat) up to 1.
+    double get_phase();
+
+   private:
+    // Calculates the spectral flux of the given amplitudes relative to the previous frame.
+    float _calc_flux(const float *amplitudes);
+
+    // Estimates the tempo from the autocorrelation of the flux history.
+    void _estimate_tempo();
+
+    // Advances the beat phase by one frame, pulling it towards the beat if there was an onset.
+    void _update_phase();
+
+    int _num_bins;
+    double _frames_per_sec;
+
+    // Variables for spectral flux
+    int _band_start[BEAT_NUM_BANDS] = {0};     // first FFT bin in each band
+    int _band_end[BEAT_NUM_BANDS] = {0};       // one past the last FFT bin in each band
+    float _avg_band_flux[BEAT_NUM_BANDS] = {0};  // running average of each band's flux, for normalization
+    float _last_amplitudes[FFT_SAMPLES / 2] = {0};
+
+    // Variables for the adaptive threshold
+    float _thresh_history[BEAT_THRESH_HISTORY] = {0};
+    int _thresh_pos = 0;
+    double _thresh_sum = 0;
+    double _thresh_sum_sq = 0;
+    int _frames_since_onset = 0;
+    bool _onset = false;
+
+    // Variables for tempo estimation
+    float _flux_history[BEAT_FLUX_HISTORY] = {0};
+    int _flux_pos = 0;                            // index of the oldest flux value
+    int _min_lag = 0;                             // shortest beat period considered, in frames
+    int _max_lag = 0;                             // longest beat period considered, in frames
+    float _lag_weights[BEAT_FLUX_HISTORY / 2] = {0};  // tempo prior for each lag
+    float _autocorr[BEAT_FLUX_HISTORY / 2] = {0};     // autocorrelation of the flux history for each lag
+    int _frames_until_tempo = 0;
+    double _tempo = 0;
+
+    // Variables for beat phase
+    double _phase = 0;
+};
+
+#endif  // _BEATDETECTOR_H
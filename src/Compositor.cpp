@@ -0,0 +1,108 @@
+#include "Compositor.h"
+
+#include "Utils.h"
+
+// Constructor
+Compositor::Compositor(LEDPanel *lp) {
+    _lp = lp;
+}
+
+int Compositor::add_layer(const char *name, CRGB *pixels, int num_leds, const uint8_t *alpha) {
+    if (_num_layers >= MAX_COMPOSITOR_LAYERS) {
+        print("Error: too many compositor layers, max is %d!\n", MAX_COMPOSITOR_LAYERS);
+        return -1;
+    }
+
+    layer_t &layer = _layers[_num_layers];
+    layer.name = name;
+    layer.pixels = pixels;
+    layer.alpha = alpha;
+    layer.num_leds = min(num_leds, NUM_LEDS);
+    layer.opacity = 0;
+    layer.fading = false;
+
+    return _num_layers++;
+}
+
+void Compositor::set_opacity(int layer, uint8_t opacity) {
+    _layers[layer].opacity = opacity;
+    _layers[layer].fading = false;
+}
+
+uint8_t Compositor::get_opacity(int layer) {
+    return _layers[layer].opacity;
+}
+
+void Compositor::fade(int layer, uint8_t opacity, uint32_t duration_ms, curve_t curve) {
+    layer_t &l = _layers[layer];
+    if (duration_ms == 0 || l.opacity == opacity) {
+        set_opacity(layer, opacity);
+        return;
+    }
+
+    l.fading = true;
+    l.fade_from = l.opacity;
+    l.fade_to = opacity;
+    l.fade_start_ms = millis();
+    l.fade_duration_ms = duration_ms;
+    l.fade_curve = curve;
+}
+
+bool Compositor::is_fading() {
+    for (int i = 0; i < _num_layers; i++) {
+        if (_layers[i].fading) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Compositor::composite() {
+#ifdef PROFILE_AUDIO
+    _profiler.begin_frame();
+#endif
+
+    uint32_t now_ms = millis();
+    for (int l = 0; l < _num_layers; l++) {
+        layer_t &layer = _layers[l];
+        _update_fade(layer, now_ms);
+
+        if (layer.opacity > 0) {
+            for (int i = 0; i < layer.num_leds; i++) {
+                uint8_t a = layer.alpha ? scale8(layer.alpha[i], layer.opacity) : layer.opacity;
+                if (a == 255) {
+                    _lp->set(i, layer.pixels[i]);
+                } else if (a > 0) {
+                    _lp->set(i, blend(_lp->get(i), layer.pixels[i], a));
+                }
+            }
+        }
+
+#ifdef PROFILE_AUDIO
+        _profiler.mark(layer.name);
+#endif
+    }
+
+#ifdef PROFILE_AUDIO
+    _profiler.end_frame();
+#endif
+}
+
+void Compositor::_update_fade(layer_t &layer, uint32_t now_ms) {
+    if (!layer.fading) {
+        return;
+    }
+
+    uint32_t elapsed_ms = now_ms - layer.fade_start_ms;
+    if (elapsed_ms >= layer.fade_duration_ms) {
+        layer.opacity = layer.fade_to;
+        layer.fading = false;
+        return;
+    }
+
+    uint8_t progress = elapsed_ms * 255 / layer.fade_duration_ms;
+    if (layer.fade_curve == CURVE_EASE_IN_OUT) {
+        progress = ease8InOutQuad(progress);
+    }
+    layer.opacity = layer.fade_from + (int(layer.fade_to) - layer.fade_from) * progress / 255;
+}
@@ -0,0 +1,77 @@
+#ifndef _COMPOSITOR_H
+#define _COMPOSITOR_H
+
+#include <Arduino.h>
+
+#include "Constants.h"
+#include "FastLED.h"
+#include "LEDPanel.h"
+#include "Profiler.h"
+
+#define MAX_COMPOSITOR_LAYERS 4
+
+// The Compositor class layers images on top of the LEDs drawn into an LEDPanel's back buffer by the current mode
+// (e.g. an audio pattern or the album art). Each layer is a buffer of colors in linear LED order, covering the
+// first num_leds LEDs, with an optional alpha value per LED and an opacity for the whole layer. composite() blends
+// the visible layers into the back buffer from the bottom up with integer alpha, one pass per layer.
+//
+// Layer opacity can be faded along a timed curve. Transitions are built from this, e.g. copy the LEDs into a
+// layer, show it at full opacity and fade it out to cross-fade to whatever is drawn underneath.
+class Compositor {
+   public:
+    // Curves for fading layer opacity over time
+    typedef enum {
+        CURVE_LINEAR,
+        CURVE_EASE_IN_OUT,
+    } curve_t;
+
+    // Constructor, accepts the LED panel whose back buffer layers will be composited onto.
+    Compositor(LEDPanel *lp);
+
+    // Adds a layer on top of the existing layers, returning its index (or -1 if there are already
+    // MAX_COMPOSITOR_LAYERS). The caller owns pixels and alpha, which hold num_leds values, and draws into them
+    // directly. If alpha is NULL, the layer covers all num_leds LEDs. Layers start hidden, with opacity 0.
+    int add_layer(const char *name, CRGB *pixels, int num_leds, const uint8_t *alpha = NULL);
+
+    // Sets/gets the opacity of a layer. Setting it stops any fade in progress.
+    void set_opacity(int layer, uint8_t opacity);
+    uint8_t get_opacity(int layer);
+
+    // Fades the opacity of a layer from its current value to the given value over duration_ms.
+    void fade(int layer, uint8_t opacity, uint32_t duration_ms, curve_t curve = CURVE_LINEAR);
+
+    // Returns true if any layer is fading.
+    bool is_fading();
+
+    // Advances any fades and blends the visible layers into the LED panel's back buffer. The caller must have
+    // exclusive access to the back buffer, as for drawing.
+    void composite();
+
+   private:
+    typedef struct layer {
+        const char *name;
+        CRGB *pixels;
+        const uint8_t *alpha;    // alpha for each LED, or NULL if the layer covers all its LEDs
+        int num_leds;
+        uint8_t opacity;
+        bool fading;
+        uint8_t fade_from;       // opacity at the start of the fade
+        uint8_t fade_to;         // opacity at the end of the fade
+        uint32_t fade_start_ms;
+        uint32_t fade_duration_ms;
+        curve_t fade_curve;
+    } layer_t;
+
+    // Updates the opacity of a fading layer for the given time.
+    void _update_fade(layer_t &layer, uint32_t now_ms);
+
+    LEDPanel *_lp;
+    layer_t _layers[MAX_COMPOSITOR_LAYERS];
+    int _num_layers = 0;
+
+#ifdef PROFILE_AUDIO
+    Profiler _profiler = Profiler("composite");  // time per layer, including hidden layers so stages line up
+#endif
+};
+
+#endif  // _COMPOSITOR_H
@@ -3,8 +3,17 @@
 
 #include <Arduino.h>
 
+#include "ConstexprMath.h"
+
 //#define SERVO_DEBUG  // uncomment for manual servo control
 //#define FFT_WHITE_NOISE_CAL  // uncomment for white noise calibration
+//#define AUDIO_SOURCE_TONE  // uncomment to drive the audio pipeline from a synthetic tone instead of the microphone
+//#define PROFILE_AUDIO  // uncomment to print per-stage audio pipeline timing over serial
+//#define FFT_FIXED_POINT  // uncomment to run the FFT and post-processing with integer math instead of float
+//#define AUDIO_BAND_EDGE_WEIGHTS  // uncomment to split FFT bins that straddle two audio bands between them
+//#define LED_NO_DITHER  // uncomment to scale LEDs to MAX_BRIGHT with FastLED instead of temporal dithering
+//#define PALETTE_MEAN_CUT_ONLY  // uncomment to use the RGB mean cut palette without refining it in Oklab
+//#define ART_FULL_RES  // uncomment to keep the 64x64 album art and point sample it for the LEDs instead of averaging
 
 // Strings
 const char* const APP_NAME = "Audiobox XL";
@@ -51,10 +60,17 @@ const uint8_t WIFI_DNS2[4] = {8, 8, 4, 4};
 
 // LED
 #define MAX_BRIGHT 60   // sets max brightness for LEDs, 100 = ~3A at full white, 60 = ~1.8A
-#define GRID_H 16       // LED panel height
-#define GRID_W 16       // LED panel width
-#define NUM_LEDS GRID_H* GRID_W
+#define PANEL_TILE_H 16  // height of each physical LED panel
+#define PANEL_TILE_W 16  // width of each physical LED panel
+#define PANEL_TILES_X 1  // number of panels across the canvas, see led_tiles in main.cpp for their pins and layout
+#define PANEL_TILES_Y 1  // number of panels up the canvas
+#define PANEL_MAX_TILES 8  // the ESP32 has 8 RMT channels, which FastLED drives in parallel
+#define GRID_H (PANEL_TILE_H * PANEL_TILES_Y)  // LED canvas height
+#define GRID_W (PANEL_TILE_W * PANEL_TILES_X)  // LED canvas width
+#define NUM_LEDS (GRID_H * GRID_W)
 #define FPS 60          // LED refresh rate
+#define DISPLAY_IDLE_MAX_MS 500  // longest the display task waits between redraws while the LEDs are not changing
+#define LED_DITHER_RESENDS FPS   // max times a frame is re-sent for dithering before settling on its rounded levels
 
 // Gamma to use for color channels (see: https://drive.google.com/file/d/1v7AEu2hqfFiiNiP1ngT0oPzDP944fT0s/view?usp=sharing)
 #define LED_GAMMA_R 3.0
@@ -67,7 +83,13 @@ const uint8_t WIFI_DNS2[4] = {8, 8, 4, 4};
 #define I2S_SAMPLE_RATE 44100   // audio sampling rate (per Nyquist, FFT will provide up frequency information up to sample_rate / 2)
 #define I2S_MIC_BIT_DEPTH 18    // SPH0645 bit depth, per datasheet (18-bit 2's complement in 24-bit container)
 #define FFT_SAMPLES 1024        // Number of audio samples to collect per FFT invocation. FFT result will have FFT_SAMPLES / 2 data points.
-#define FFTS_PER_SEC int(double(I2S_SAMPLE_RATE) / FFT_SAMPLES)  // number of FFTs computed each sec
+#define FFT_OVERLAP_SHIFT 1     // overlap between successive FFTs: 1 = 50%, 2 = 75%, 3 = 87.5%
+#define FFT_HOP_SAMPLES (FFT_SAMPLES >> FFT_OVERLAP_SHIFT)           // number of new audio samples collected per FFT
+#define FFT_WINDOW FFT_WINDOW_HANN  // default window applied to audio samples before the FFT
+#define FFTS_PER_SEC int(double(I2S_SAMPLE_RATE) / FFT_HOP_SAMPLES)  // number of FFTs computed each sec
+#define AUDIO_FRAME_QUEUE_LEN 4      // number of audio frames that can be queued between the audio and render tasks, must be a power of 2
+#define AUDIO_FRAME_TIMEOUT_MS 100   // how long the render task waits for a new audio frame before re-checking the mode
+#define AUDIO_TONE_FREQ 440     // frequency of the synthetic tone used with AUDIO_SOURCE_TONE
 
 // Timeouts and delays
 #define DURATION_MS_ART 10000               // how long to display the album art before switching modes
@@ -77,8 +99,12 @@ const uint8_t WIFI_DNS2[4] = {8, 8, 4, 4};
 #define WIFI_TIMEOUT_MS 10000               // how long to wait on wifi connect before bailing out
 
 // Mean cut
-#define MEAN_CUT_DEPTH 4                        // recursive depth for mean cut algorithm (results in 2^MEAN_CUT_DEPTH colors)
+#define MEAN_CUT_DEPTH 4                        // number of mean cut splits (results in 2^MEAN_CUT_DEPTH colors)
 #define PALETTE_ENTRIES (1 << MEAN_CUT_DEPTH)   // number of color palette entries
+#define PALETTE_ART_STEP 1                      // palette is calculated from every Nth row/col of the art (4 for 16x16)
+#define PALETTE_ART_SIZE (64 / PALETTE_ART_STEP)  // width and height of the art sampled for the palette
+#define PALETTE_KMEANS_ITERATIONS 8             // max refinement passes over the art for the Oklab palette
+#define PALETTE_CACHE_ENTRIES 8                 // number of recent album art palettes to keep, keyed by art URL
 
 // Servo
 #define SERVO_MIN_US 700        // minimum servo PWM setting in microseconds
@@ -119,6 +145,36 @@ enum AudioSubMode {
     MODE_AUDIO_SUBMODE_MAX,
 };
 
+// Band analysis scales (see Filterbank.h)
+enum FilterbankScale {
+    FILTERBANK_NONE,  // use the log-spaced audio bands or perceptual binning instead of a filterbank
+    FILTERBANK_MEL,
+    FILTERBANK_BARK,
+    FILTERBANK_ERB,
+    FILTERBANK_MAX,
+};
+
+// Filterbank to use for each audio submode, in AudioSubMode order
+const FilterbankScale AUDIO_FILTERBANK[MODE_AUDIO_SUBMODE_MAX] = {
+    FILTERBANK_NONE,  // MODE_AUDIO_NOISE
+    FILTERBANK_NONE,  // MODE_AUDIO_SNAKE_GRID
+    FILTERBANK_MEL,   // MODE_AUDIO_BARS
+    FILTERBANK_MEL,   // MODE_AUDIO_CENTER_BARS
+    FILTERBANK_NONE,  // MODE_AUDIO_WATERFALL
+    FILTERBANK_NONE,  // MODE_AUDIO_MODES_MAX
+    FILTERBANK_NONE,  // MODE_AUDIO_SCROLLING
+    FILTERBANK_MEL,   // MODE_AUDIO_OUTRUN_BARS
+};
+
+// FFT windows (see FFTWindow.h)
+enum FFTWindowType {
+    FFT_WINDOW_RECTANGULAR,      // no window
+    FFT_WINDOW_HANN,             // good general-purpose frequency resolution
+    FFT_WINDOW_BLACKMAN_HARRIS,  // lowest leakage, wider peaks
+    FFT_WINDOW_FLAT_TOP,         // most accurate peak amplitudes, widest peaks
+    FFT_WINDOW_MAX,
+};
+
 // Audio volume control
 #define VOL_FACTOR 10                        // empirically found that RMS of signal needs x10 to match RMS of FFT
 #define VOL_MULT 0.4 * 256 / FFT_SAMPLES     // multiplier to go from volume to FFT max value, scaled by FFT_SAMPLES because more samples = less energy per bin
@@ -127,9 +183,24 @@ enum AudioSubMode {
 #define VOL_THRESH_DB -65                    // threshold below which we shouldn't update LEDs as FFT data may not be reliable
 #define FFT_FIXED_MAX_VAL 0.0014 * VOL_MULT  // value to use when not volume scaling
 
+// Beat detection (see BeatDetector.h)
+const float BEAT_BAND_EDGES_HZ[] = {40, 150, 500, 2000, 8000};  // edges of the bands used to calculate spectral flux
+#define BEAT_BAND_AVG_SCALE 0.01     // exponential moving averaging scale factor for normalizing each band's flux
+#define BEAT_THRESH_HISTORY 32       // number of frames used for the adaptive onset threshold, must be a power of 2
+#define BEAT_THRESH_STD 1.5          // onsets must exceed the mean flux by this many standard deviations
+#define BEAT_THRESH_MIN_RATIO 3.0    // and must also be at least this many times the mean flux
+#define BEAT_MIN_INTERVAL_MS 100     // minimum time between onsets
+#define BEAT_TEMPO_UPDATE_FRAMES 16  // number of frames between tempo estimates
+#define BEAT_MIN_BPM 60
+#define BEAT_MAX_BPM 180
+#define BEAT_MAX_PERIOD_FRAMES (int(60.0 * I2S_SAMPLE_RATE / FFT_HOP_SAMPLES / BEAT_MIN_BPM) + 1)  // longest beat period searched, rounded up
+#define BEAT_FLUX_HISTORY int(constexpr_math::ceil_pow2(2 * (BEAT_MAX_PERIOD_FRAMES + 2)))  // frames used for tempo estimation: two of the longest periods, plus a lag either side for smoothing, as a power of 2
+#define BEAT_PRIOR_BPM 120           // tempo estimates are biased towards this tempo to avoid half/double tempo errors
+#define BEAT_MIN_CONFIDENCE 0.1      // minimum normalized autocorrelation for a tempo to be reported
+#define BEAT_PHASE_GAIN 0.2          // how strongly each onset pulls the beat phase towards it
+#define NOISE_BEAT_SPEED 8           // how much the noise pattern speeds up on each beat
+
 // Audio bands for vertical bar visualizations
-#define LOWEST_BASS_FREQ 60
-#define HIGHEST_BASS_FREQ 130
 #define LOWEST_FREQ_BAND 60
 #define HIGHEST_FREQ_BAND I2S_SAMPLE_RATE / 2
 #define NUM_AUDIO_BANDS 16
@@ -140,7 +211,10 @@ enum AudioSubMode {
 #define MIN_BRIGHT_UPDATE 32                  // Cut-off for new values (this is a 5 in the gamma table)
 #define FADE BRIGHT_LEVELS / 32 * 30 / FPS    // Rate at which LEDs will fade out (remember, gamma will be applied so fall off will seem faster).                                                           // Scale by FPS so that the fade speed is always the same.
 #define LED_SMOOTHING 0.75 * 30 / FPS         // smoothing factor for updating LEDs
+#define LED_SMOOTHING_Q8 int((LED_SMOOTHING) * 256 + 0.5)  // smoothing factor in Q8, for integer smoothing
+#define ART_FADE_MS 500                       // time to cross-fade to the album art when it changes
 #define FFT_SCALE_POWER 1.5                   // power by which to scale the FFT for LED intensity
+#define INTENSITY_LUT_SIZE 1024               // number of FFT magnitude steps in the LED intensity lookup table
 #define PALETTE_CHANGE_RATE 24                // default from https://gist.github.com/kriegsman/1f7ccbbfa492a73c015e
 #define PEAK_DECAY_RATE int(round(FPS / 16))  // rate at which peak decays on vertical bar visualization
 
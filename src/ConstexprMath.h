@@ -0,0 +1,87 @@
+#ifndef _CONSTEXPRMATH_H
+#define _CONSTEXPRMATH_H
+
+// Compile-time math helpers, since the cmath functions are not constexpr.
+namespace constexpr_math {
+constexpr double PI_VAL = 3.14159265358979323846;
+
+// Cosine via range reduction to [-pi, pi] followed by a Taylor series, accurate to well below Q15 precision
+constexpr double cos(double x) {
+    while (x > PI_VAL) x -= 2 * PI_VAL;
+    while (x < -PI_VAL) x += 2 * PI_VAL;
+
+    double x2 = x * x;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= -x2 / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr long round(double x) {
+    return x >= 0 ? long(x + 0.5) : -long(-x + 0.5);
+}
+
+// Natural log, for x > 0. x is reduced to m * 2^k with m in [1, 2), and log(m) is found from the series for
+// 2 * atanh((m - 1) / (m + 1)).
+constexpr double log(double x) {
+    int k = 0;
+    while (x >= 2) {
+        x /= 2;
+        k++;
+    }
+    while (x < 1) {
+        x *= 2;
+        k--;
+    }
+
+    double z = (x - 1) / (x + 1);
+    double z2 = z * z;
+    double term = z;
+    double sum = 0;
+    for (int n = 1; n < 60; n += 2) {
+        sum += term / n;
+        term *= z2;
+    }
+    return 2 * sum + k * 0.69314718055994530942;
+}
+
+// Exponential, halving x until it is small, summing a Taylor series and squaring the result back up
+constexpr double exp(double x) {
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5) {
+        x /= 2;
+        halvings++;
+    }
+
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    for (int i = 0; i < halvings; i++) {
+        sum *= sum;
+    }
+    return sum;
+}
+
+// x raised to the power y, for x >= 0
+constexpr double pow(double x, double y) {
+    if (x == 0) {
+        return y == 0 ? 1.0 : 0.0;
+    }
+    return exp(y * log(x));
+}
+
+// Smallest power of 2 that is >= x
+constexpr long ceil_pow2(long x) {
+    long p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+}  // namespace constexpr_math
+
+#endif  // _CONSTEXPRMATH_H
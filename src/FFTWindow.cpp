@@ -0,0 +1,33 @@
+#include "FFTWindow.h"
+
+// Window tables are generated by the compiler and stored in flash
+static constexpr FFTWindowTable<FFT_SAMPLES> WINDOW_RECTANGULAR(1.0, 0.0, 0.0, 0.0, 0.0);
+static constexpr FFTWindowTable<FFT_SAMPLES> WINDOW_HANN(0.5, 0.5, 0.0, 0.0, 0.0);
+static constexpr FFTWindowTable<FFT_SAMPLES> WINDOW_BLACKMAN_HARRIS(0.35875, 0.48829, 0.14128, 0.01168, 0.0);
+static constexpr FFTWindowTable<FFT_SAMPLES> WINDOW_FLAT_TOP(0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368);
+
+const FFTWindowTable<FFT_SAMPLES> *get_fft_window(FFTWindowType type) {
+    switch (type) {
+        case FFT_WINDOW_HANN:
+            return &WINDOW_HANN;
+        case FFT_WINDOW_BLACKMAN_HARRIS:
+            return &WINDOW_BLACKMAN_HARRIS;
+        case FFT_WINDOW_FLAT_TOP:
+            return &WINDOW_FLAT_TOP;
+        default:
+            return &WINDOW_RECTANGULAR;
+    }
+}
+
+const char *get_fft_window_name(FFTWindowType type) {
+    switch (type) {
+        case FFT_WINDOW_HANN:
+            return "hann";
+        case FFT_WINDOW_BLACKMAN_HARRIS:
+            return "blackman-harris";
+        case FFT_WINDOW_FLAT_TOP:
+            return "flat-top";
+        default:
+            return "rectangular";
+    }
+}
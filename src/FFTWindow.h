@@ -0,0 +1,43 @@
+#ifndef _FFTWINDOW_H
+#define _FFTWINDOW_H
+
+#include <Arduino.h>
+
+#include "ConstexprMath.h"
+#include "Constants.h"
+
+#define FFT_WINDOW_Q_BITS 15  // window coefficients are stored as Q15, i.e. 1.0 = 1 << FFT_WINDOW_Q_BITS
+#define FFT_WINDOW_GAIN_Q_BITS 16  // inverse coherent gains are stored as Q16
+
+// A table of window coefficients for an FFT of size N, generated at compile time from a generalized cosine
+// window (see: https://en.wikipedia.org/wiki/Window_function#Cosine-sum_windows):
+//      w[n] = a0 - a1 * cos(2*pi*n/N) + a2 * cos(4*pi*n/N) - a3 * cos(6*pi*n/N) + a4 * cos(8*pi*n/N)
+// The periodic (DFT-even) form is used, as is standard for spectral analysis.
+//
+// Declaring a table constexpr places it in flash rather than RAM.
+template <int N>
+struct FFTWindowTable {
+    int16_t coeffs[N];   // Q15 window coefficients
+    int32_t inv_gain;    // Q16 inverse of the coherent gain (the mean of the window), used to restore tone amplitudes
+
+    constexpr FFTWindowTable(double a0, double a1, double a2, double a3, double a4) : coeffs(), inv_gain(0) {
+        double sum = 0;
+        for (int n = 0; n < N; n++) {
+            double angle = 2 * constexpr_math::PI_VAL * n / N;
+            double w = a0 - a1 * constexpr_math::cos(angle) + a2 * constexpr_math::cos(2 * angle) -
+                       a3 * constexpr_math::cos(3 * angle) + a4 * constexpr_math::cos(4 * angle);
+            long q = constexpr_math::round(w * (1 << FFT_WINDOW_Q_BITS));
+            coeffs[n] = int16_t(q > INT16_MAX ? INT16_MAX : (q < INT16_MIN ? INT16_MIN : q));
+            sum += coeffs[n];
+        }
+        inv_gain = int32_t(constexpr_math::round(double(N) * (1 << FFT_WINDOW_Q_BITS) / sum * (1 << FFT_WINDOW_GAIN_Q_BITS)));
+    }
+};
+
+// Returns the window table for FFT_SAMPLES (defined in Constants.h) of the given type.
+const FFTWindowTable<FFT_SAMPLES> *get_fft_window(FFTWindowType type);
+
+// Returns the name of the given window type, for printing.
+const char *get_fft_window_name(FFTWindowType type);
+
+#endif  // _FFTWINDOW_H
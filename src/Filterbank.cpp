@@ -0,0 +1,117 @@
+#include "Filterbank.h"
+
+#include "Utils.h"
+
+// Constructor, calculates the filter weights and stores them sparsely
+Filterbank::Filterbank(FilterbankScale scale, int num_filters, int num_bins, double first_bin_freq, double bin_width,
+                       double low_freq, double high_freq) {
+    _scale = scale;
+    _num_filters = num_filters;
+    _start = new uint16_t[num_filters];
+    _len = new uint16_t[num_filters];
+
+    // Filter edges are evenly spaced on the scale, with each filter spanning from the center of the previous
+    // filter to the center of the next
+    double low_val = hz_to_scale(scale, low_freq);
+    double high_val = hz_to_scale(scale, high_freq);
+    double *edges_hz = new double[num_filters + 2];  // on the heap, as num_filters is only known at run time
+    for (int i = 0; i < num_filters + 2; i++) {
+        edges_hz[i] = scale_to_hz(scale, low_val + i * (high_val - low_val) / (num_filters + 1));
+    }
+
+    // First pass finds the range of bins covered by each filter, so we know how many weights to allocate
+    int num_weights = 0;
+    for (int f = 0; f < num_filters; f++) {
+        int start = max(int(floor((edges_hz[f] - first_bin_freq) / bin_width)) + 1, 0);     // first bin above the left edge
+        int end = min(int(ceil((edges_hz[f + 2] - first_bin_freq) / bin_width)) - 1, num_bins - 1);  // last bin below the right edge
+
+        if (end < start) {  // filter is narrower than a bin, so use the bin nearest the center
+            start = constrain(int(round((edges_hz[f + 1] - first_bin_freq) / bin_width)), 0, num_bins - 1);
+            end = start;
+        }
+        _start[f] = start;
+        _len[f] = end - start + 1;
+        num_weights += _len[f];
+    }
+
+    // Second pass fills in the triangular weights
+    _weights = new float[num_weights];
+    float *w = _weights;
+    for (int f = 0; f < num_filters; f++) {
+        double left = edges_hz[f];
+        double center = edges_hz[f + 1];
+        double right = edges_hz[f + 2];
+
+        for (int i = 0; i < _len[f]; i++) {
+            double freq = first_bin_freq + (_start[f] + i) * bin_width;
+            double weight = 0;
+            if (freq > left && freq <= center) {
+                weight = (freq - left) / (center - left);
+            } else if (freq > center && freq < right) {
+                weight = (right - freq) / (right - center);
+            }
+            w[i] = weight;
+        }
+        if (_len[f] == 1 && w[0] <= 0) {
+            w[0] = 1.0;  // the nearest bin to a narrow filter gets the full weight
+        }
+        w += _len[f];
+    }
+    delete[] edges_hz;
+
+    print("Filterbank with %d filters, %d weights\n", num_filters, num_weights);
+}
+
+Filterbank::~Filterbank() {
+    delete[] _start;
+    delete[] _len;
+    delete[] _weights;
+}
+
+void Filterbank::apply(const float *amplitudes, float *out) {
+    const float *w = _weights;
+    for (int f = 0; f < _num_filters; f++) {
+        const float *a = &amplitudes[_start[f]];
+        float sum = 0;
+        for (int i = 0; i < _len[f]; i++) {
+            sum += a[i] * w[i];
+        }
+        out[f] = sum;
+        w += _len[f];
+    }
+}
+
+FilterbankScale Filterbank::get_scale() {
+    return _scale;
+}
+
+int Filterbank::get_num_filters() {
+    return _num_filters;
+}
+
+// Mel (HTK formula), Bark (Traunmüller, 1990) and ERB-rate (Glasberg & Moore, 1990) scales
+double Filterbank::hz_to_scale(FilterbankScale scale, double hz) {
+    switch (scale) {
+        case FILTERBANK_MEL:
+            return 2595.0 * log10(1.0 + hz / 700.0);
+        case FILTERBANK_BARK:
+            return 26.81 * hz / (1960.0 + hz) - 0.53;
+        case FILTERBANK_ERB:
+            return 21.4 * log10(1.0 + 0.00437 * hz);
+        default:
+            return hz;
+    }
+}
+
+double Filterbank::scale_to_hz(FilterbankScale scale, double val) {
+    switch (scale) {
+        case FILTERBANK_MEL:
+            return 700.0 * (pow(10.0, val / 2595.0) - 1.0);
+        case FILTERBANK_BARK:
+            return 1960.0 * (val + 0.53) / (26.28 - val);
+        case FILTERBANK_ERB:
+            return (pow(10.0, val / 21.4) - 1.0) / 0.00437;
+        default:
+            return val;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef _FILTERBANK_H
+#define _FILTERBANK_H
+
+#include <Arduino.h>
+
+#include "Constants.h"
+
+// The Filterbank class maps FFT amplitudes to a set of overlapping triangular filters spaced evenly on a
+// perceptual frequency scale (mel, Bark or ERB). Each filter peaks at 1.0 at its center frequency and falls
+// to 0 at the centers of its neighbors, so adjacent filters overlap by half.
+//
+// Filter weights are calculated once in the constructor and stored sparsely: each filter only stores the
+// weights for the contiguous run of FFT bins it covers, so applying the filterbank is a single pass over
+// roughly twice the number of FFT bins regardless of the number of filters.
+class Filterbank {
+   public:
+    // Constructor, accepts the scale to space the filters on, the number of filters, the number of FFT
+    // amplitudes that will be passed to apply() (and the frequency of the first one), the width of each
+    // FFT bin in Hz, and the frequency range to cover.
+    Filterbank(FilterbankScale scale, int num_filters, int num_bins, double first_bin_freq, double bin_width,
+               double low_freq, double high_freq);
+    ~Filterbank();
+
+    // Applies the filterbank to num_bins FFT amplitudes, writing num_filters outputs to out.
+    void apply(const float *amplitudes, float *out);
+
+    // Returns the scale the filters are spaced on.
+    FilterbankScale get_scale();
+
+    // Returns the number of filters.
+    int get_num_filters();
+
+    // Converts between a frequency in Hz and a position on the given scale.
+    static double hz_to_scale(FilterbankScale scale, double hz);
+    static double scale_to_hz(FilterbankScale scale, double val);
+
+   private:
+    FilterbankScale _scale;
+    int _num_filters;
+    uint16_t *_start;   // first FFT bin covered by each filter
+    uint16_t *_len;     // number of FFT bins covered by each filter
+    float *_weights;    // weights for all filters, packed back to back
+};
+
+#endif  // _FILTERBANK_H
@@ -0,0 +1,111 @@
+#include "FixedFFT.h"
+
+// Multiplies two Q31 values
+static inline int32_t q31_mul(int32_t a, int32_t b) {
+    return int32_t((int64_t(a) * b) >> 31);
+}
+
+// Constructor, allocates working buffers and pre-computes the twiddle factors and bit-reversed indices
+FixedFFT::FixedFFT(int size) {
+    _size = size;
+    _half_size = size / 2;
+
+    _buf = new int32_t[size];
+    _cos = new int32_t[_half_size];
+    _sin = new int32_t[_half_size];
+    _bitrev = new uint16_t[_half_size];
+
+    for (int k = 0; k < _half_size; k++) {
+        double angle = 2 * PI * k / size;
+        _cos[k] = int32_t(constrain(round(cos(angle) * 2147483648.0), -2147483647.0, 2147483647.0));
+        _sin[k] = int32_t(constrain(round(sin(angle) * 2147483648.0), -2147483647.0, 2147483647.0));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < _half_size) bits++;
+    for (int i = 0; i < _half_size; i++) {
+        int rev = 0;
+        for (int b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        _bitrev[i] = rev;
+    }
+}
+
+FixedFFT::~FixedFFT() {
+    delete[] _buf;
+    delete[] _cos;
+    delete[] _sin;
+    delete[] _bitrev;
+}
+
+void FixedFFT::execute(const int32_t *input) {
+    int n = _half_size;
+
+    // Pack even samples into the real part and odd samples into the imaginary part, in bit-reversed order
+    for (int i = 0; i < n; i++) {
+        int rev = _bitrev[i];
+        _buf[rev * 2] = input[i * 2];
+        _buf[rev * 2 + 1] = input[i * 2 + 1];
+    }
+
+    // Iterative radix-2 decimation-in-time butterflies, scaling by 1/2 at each stage
+    for (int span = 2; span <= n; span <<= 1) {
+        int half = span / 2;
+        int twiddle_step = _size / span;  // twiddle index stride in terms of the size N table
+
+        for (int start = 0; start < n; start += span) {
+            for (int j = 0; j < half; j++) {
+                int32_t c = _cos[j * twiddle_step];
+                int32_t s = _sin[j * twiddle_step];
+
+                int32_t *a = &_buf[(start + j) * 2];
+                int32_t *b = &_buf[(start + j + half) * 2];
+
+                // t = b * e^(-i * angle)
+                int32_t t_re = q31_mul(c, b[0]) + q31_mul(s, b[1]);
+                int32_t t_im = q31_mul(c, b[1]) - q31_mul(s, b[0]);
+
+                b[0] = (a[0] - t_re) >> 1;
+                b[1] = (a[1] - t_im) >> 1;
+                a[0] = (a[0] + t_re) >> 1;
+                a[1] = (a[1] + t_im) >> 1;
+            }
+        }
+    }
+}
+
+void FixedFFT::get_amplitudes(int32_t *amplitudes) {
+    int n = _half_size;
+
+    // Split the N/2-point complex spectrum Z into the real spectrum X:
+    //      X[k] = Fe[k] + e^(-2*pi*i*k/N) * Fo[k]
+    //      Fe[k] = (Z[k] + conj(Z[N/2 - k])) / 2
+    //      Fo[k] = (Z[k] - conj(Z[N/2 - k])) / 2i
+    for (int k = 1; k < n; k++) {
+        int32_t a = _buf[k * 2];
+        int32_t b = _buf[k * 2 + 1];
+        int32_t c = _buf[(n - k) * 2];
+        int32_t d = _buf[(n - k) * 2 + 1];
+
+        int32_t fe_re = (a + c) >> 1;
+        int32_t fe_im = (b - d) >> 1;
+        int32_t fo_re = (b + d) >> 1;
+        int32_t fo_im = (c - a) >> 1;
+
+        int32_t x_re = fe_re + q31_mul(_cos[k], fo_re) + q31_mul(_sin[k], fo_im);
+        int32_t x_im = fe_im + q31_mul(_cos[k], fo_im) - q31_mul(_sin[k], fo_re);
+
+        amplitudes[k - 1] = _approx_magnitude(x_re, x_im);
+    }
+}
+
+int32_t FixedFFT::_approx_magnitude(int32_t re, int32_t im) {
+    uint32_t abs_re = re < 0 ? -re : re;
+    uint32_t abs_im = im < 0 ? -im : im;
+    uint32_t max_val = abs_re > abs_im ? abs_re : abs_im;
+    uint32_t min_val = abs_re > abs_im ? abs_im : abs_re;
+
+    // alpha = 123/128 (~0.960), beta = 51/128 (~0.398)
+    return int32_t((uint64_t(max_val) * 123 + uint64_t(min_val) * 51) >> 7);
+}
@@ -0,0 +1,43 @@
+#ifndef _FIXEDFFT_H
+#define _FIXEDFFT_H
+
+#include <Arduino.h>
+
+#define FIXED_FFT_INPUT_BITS 28  // input samples in the range ±1.0 are represented as ±(1 << FIXED_FFT_INPUT_BITS)
+
+// The FixedFFT class implements a real-valued forward FFT in Q31 fixed-point arithmetic, for use on
+// processors without a double-precision FPU (such as the ESP32). The real input of length N is packed
+// into an N/2-point complex FFT (even samples as the real part, odd samples as the imaginary part),
+// which is then split back into the N/2 bins of the real spectrum.
+//
+// Every butterfly stage scales its output by 1/2 so intermediate values can never overflow, as long
+// as the input stays within ±(1 << (FIXED_FFT_INPUT_BITS + 1)). This scaling also makes the output
+// directly comparable to the float path: for an input of amplitude 1.0 (i.e. 1 << FIXED_FFT_INPUT_BITS),
+// a pure tone produces an amplitude of 1 << FIXED_FFT_INPUT_BITS in its bin.
+class FixedFFT {
+   public:
+    // Constructor, accepts the FFT size. Must be a power of 2.
+    FixedFFT(int size);
+    ~FixedFFT();
+
+    // Performs the FFT on size real input samples. The input is not modified.
+    void execute(const int32_t *input);
+
+    // Calculates the approximate amplitude of bins 1 to size/2 - 1 (i.e. skipping the DC term) using
+    // integer math, and stores them in amplitudes, which must hold at least size/2 - 1 values.
+    void get_amplitudes(int32_t *amplitudes);
+
+   private:
+    // Approximates sqrt(re^2 + im^2) without a square root (alpha max plus beta min).
+    // Maximum error is roughly 4%.
+    static int32_t _approx_magnitude(int32_t re, int32_t im);
+
+    int _size;         // real FFT size (N)
+    int _half_size;    // complex FFT size (N/2)
+    int32_t *_buf;     // interleaved complex working buffer, N/2 complex values
+    int32_t *_cos;     // Q31 cos(2*pi*k/N) for k in [0, N/2)
+    int32_t *_sin;     // Q31 sin(2*pi*k/N) for k in [0, N/2)
+    uint16_t *_bitrev; // bit-reversed index of each of the N/2 complex values
+};
+
+#endif  // _FIXEDFFT_H
@@ -0,0 +1,52 @@
+#ifndef _FRAMEQUEUE_H
+#define _FRAMEQUEUE_H
+
+#include <Arduino.h>
+
+#include <atomic>
+
+// The FrameQueue class is a lock-free single-producer/single-consumer ring of frames, intended to pass data
+// between two tasks that may be pinned to different cores. Exactly one task may call push() and exactly one
+// (other) task may call pop(); neither call ever blocks, so the producer is never held up by a slow consumer.
+// Frames are copied in and out of the queue. SIZE must be a power of 2.
+template <typename T, int SIZE>
+class FrameQueue {
+   public:
+    // Copies frame into the queue. Returns false (and drops the frame) if the queue is full.
+    bool push(const T &frame) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= SIZE) {
+            return false;
+        }
+
+        _frames[head & (SIZE - 1)] = frame;
+        _head.store(head + 1, std::memory_order_release);  // publish the frame only once it is fully written
+        return true;
+    }
+
+    // Copies the oldest frame out of the queue. Returns false if the queue is empty.
+    bool pop(T &frame) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        frame = _frames[tail & (SIZE - 1)];
+        _tail.store(tail + 1, std::memory_order_release);  // release the slot only once it is fully read
+        return true;
+    }
+
+    // Returns the number of frames currently in the queue.
+    int available() {
+        return int(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+    }
+
+   private:
+    static_assert((SIZE & (SIZE - 1)) == 0, "FrameQueue SIZE must be a power of 2");
+
+    T _frames[SIZE];
+    std::atomic<uint32_t> _head{0};  // total frames pushed, only written by the producer
+    std::atomic<uint32_t> _tail{0};  // total frames popped, only written by the consumer
+};
+
+#endif  // _FRAMEQUEUE_H
@@ -0,0 +1,27 @@
+#include "GammaTable.h"
+
+// Gamma tables are generated by the compiler and stored in flash
+static constexpr GammaTable<32> GAMMA_R5(LED_GAMMA_R / JPG_GAMMA);
+static constexpr GammaTable<64> GAMMA_G6(LED_GAMMA_G / JPG_GAMMA);
+static constexpr GammaTable<32> GAMMA_B5(LED_GAMMA_B / JPG_GAMMA);
+static constexpr GammaTable<256> GAMMA_R8(LED_GAMMA_R / JPG_GAMMA);
+static constexpr GammaTable<256> GAMMA_G8(LED_GAMMA_G / JPG_GAMMA);
+static constexpr GammaTable<256> GAMMA_B8(LED_GAMMA_B / JPG_GAMMA);
+static constexpr GammaTable<32> LINEAR_5(1.0);
+static constexpr GammaTable<64> LINEAR_6(1.0);
+
+CRGB rgb565_to_led_crgb(uint16_t rgb565_val) {
+    return CRGB(GAMMA_R5.values[(rgb565_val >> 11) & 0x1F],
+                GAMMA_G6.values[(rgb565_val >> 5) & 0x3F],
+                GAMMA_B5.values[rgb565_val & 0x1F]);
+}
+
+CRGB rgb565_to_crgb(uint16_t rgb565_val) {
+    return CRGB(LINEAR_5.values[(rgb565_val >> 11) & 0x1F],
+                LINEAR_6.values[(rgb565_val >> 5) & 0x3F],
+                LINEAR_5.values[rgb565_val & 0x1F]);
+}
+
+CRGB rgb888_to_led_crgb(const uint8_t *rgb888_arr) {
+    return CRGB(GAMMA_R8.values[rgb888_arr[0]], GAMMA_G8.values[rgb888_arr[1]], GAMMA_B8.values[rgb888_arr[2]]);
+}
@@ -0,0 +1,36 @@
+#ifndef _GAMMATABLE_H
+#define _GAMMATABLE_H
+
+#include <Arduino.h>
+
+#include "ConstexprMath.h"
+#include "Constants.h"
+#include "FastLED.h"
+
+// A table mapping each of the LEVELS values of a color channel to an 8-bit LED value raised to the given gamma,
+// i.e. values[i] = round((i / (LEVELS - 1)) ^ gamma * 255). Tables are generated at compile time, so that
+// converting artwork to LED colors is a lookup per channel instead of a pow() per channel.
+//
+// Declaring a table constexpr places it in flash rather than RAM.
+template <int LEVELS>
+struct GammaTable {
+    uint8_t values[LEVELS];
+
+    constexpr GammaTable(double gamma) : values() {
+        for (int i = 0; i < LEVELS; i++) {
+            values[i] = uint8_t(constexpr_math::round(constexpr_math::pow(double(i) / (LEVELS - 1), gamma) * 255));
+        }
+    }
+};
+
+// Converts an RGB565 pixel from the artwork to an LED color, undoing the JPG gamma and applying the LED gamma.
+CRGB rgb565_to_led_crgb(uint16_t rgb565_val);
+
+// Converts an RGB565 pixel to an LED color with no gamma correction.
+CRGB rgb565_to_crgb(uint16_t rgb565_val);
+
+// Converts an array of 3 RGB888 values from the artwork to an LED color, undoing the JPG gamma and applying the
+// LED gamma.
+CRGB rgb888_to_led_crgb(const uint8_t *rgb888_arr);
+
+#endif  // _GAMMATABLE_H
@@ -1,6 +1,184 @@
 #include "LEDAudioPattern.h"
 
 #include "LEDPanel.h"
+#include "Utils.h"
+
+// Scales a color from the palette LUT by brightness, exactly as ColorFromPalette() does
+static inline CRGB scale_palette_color(CRGB color, uint8_t brightness) {
+    if (brightness == 255) {
+        return color;
+    }
+    if (brightness == 0) {
+        return CRGB::Black;
+    }
+
+    brightness++;  // adjust for rounding
+    for (int i = 0; i < 3; i++) {
+        if (color.raw[i]) {
+            color.raw[i] = scale8(color.raw[i], brightness);
+#if !(FASTLED_SCALE8_FIXED == 1)
+            color.raw[i]++;
+#endif
+        }
+    }
+    return color;
+}
+
+// Permutation table used by FastLED's noise functions (Ken Perlin's), for hashing lattice coordinates
+static const uint8_t PROGMEM NOISE_PERMUTATION[256] = {
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+};
+
+static inline uint8_t noise_hash(uint8_t i) {
+    return pgm_read_byte(&NOISE_PERMUTATION[i]);
+}
+
+// Gradient function from FastLED's noise
+static inline int8_t noise_grad8(uint8_t hash, int8_t x, int8_t y, int8_t z) {
+    hash &= 0xF;
+    int8_t u = (hash & 8) ? y : x;
+    int8_t v = (hash < 4) ? y : (hash == 12 || hash == 14) ? x : z;
+    if (hash & 1) {
+        u = -u;
+    }
+    if (hash & 2) {
+        v = -v;
+    }
+    return avg7(u, v);
+}
+
+// Linear interpolation from FastLED's noise
+static inline int8_t noise_lerp7by8(int8_t a, int8_t b, fract8 frac) {
+    if (b > a) {
+        return a + scale8(uint8_t(b - a), frac);
+    } else {
+        return a - scale8(uint8_t(a - b), frac);
+    }
+}
+
+// Fills out[n] with inoise8(x, y + n * y_step, z) for n = 0..num-1, giving the same values as FastLED. Along the
+// row only y changes, so the x and z terms are calculated once, and the lattice hashes (and the gradients they
+// select) only change when y crosses into the next lattice cell.
+static void inoise8_row(uint16_t x, uint16_t y, uint16_t y_step, uint16_t z, uint8_t *out, int num) {
+    const uint8_t N = 0x80;
+    uint8_t X = x >> 8;
+    uint8_t Z = z >> 8;
+    uint8_t u = ease8InOutQuad(uint8_t(x));
+    uint8_t w = ease8InOutQuad(uint8_t(z));
+    int8_t xx = (uint8_t(x) >> 1) & 0x7F;
+    int8_t zz = (uint8_t(z) >> 1) & 0x7F;
+    uint8_t hash_x0 = noise_hash(X);
+    uint8_t hash_x1 = noise_hash(X + 1);
+
+    int cell = -1;
+    uint8_t hash[8];  // hashes of the 8 corners of the current lattice cell
+    for (int n = 0; n < num; n++, y += y_step) {
+        uint8_t Y = y >> 8;
+        if (Y != cell) {
+            uint8_t A = hash_x0 + Y;
+            uint8_t AA = noise_hash(A) + Z;
+            uint8_t AB = noise_hash(A + 1) + Z;
+            uint8_t B = hash_x1 + Y;
+            uint8_t BA = noise_hash(B) + Z;
+            uint8_t BB = noise_hash(B + 1) + Z;
+            hash[0] = noise_hash(AA);
+            hash[1] = noise_hash(BA);
+            hash[2] = noise_hash(AB);
+            hash[3] = noise_hash(BB);
+            hash[4] = noise_hash(AA + 1);
+            hash[5] = noise_hash(BA + 1);
+            hash[6] = noise_hash(AB + 1);
+            hash[7] = noise_hash(BB + 1);
+            cell = Y;
+        }
+
+        uint8_t v = ease8InOutQuad(uint8_t(y));
+        int8_t yy = (uint8_t(y) >> 1) & 0x7F;
+
+        int8_t x1 = noise_lerp7by8(noise_grad8(hash[0], xx, yy, zz), noise_grad8(hash[1], xx - N, yy, zz), u);
+        int8_t x2 = noise_lerp7by8(noise_grad8(hash[2], xx, yy - N, zz), noise_grad8(hash[3], xx - N, yy - N, zz), u);
+        int8_t x3 = noise_lerp7by8(noise_grad8(hash[4], xx, yy, zz - N), noise_grad8(hash[5], xx - N, yy, zz - N), u);
+        int8_t x4 = noise_lerp7by8(noise_grad8(hash[6], xx, yy - N, zz - N), noise_grad8(hash[7], xx - N, yy - N, zz - N), u);
+        int8_t y1 = noise_lerp7by8(x1, x2, v);
+        int8_t y2 = noise_lerp7by8(x3, x4, v);
+        int8_t val = noise_lerp7by8(y1, y2, w) + 64;  // -64..64 to 0..128
+
+        out[n] = qadd8(val, val);
+    }
+}
+
+#define NOISE_CHECK_ROWS 64  // rows compared with inoise8() by check_row_noise()
+#define NOISE_CHECK_LEN 64   // points in each row, as many as on a 64x64 canvas
+
+#ifdef PROFILE_AUDIO
+// Prints the time to fill a size x size noise field with inoise8_row() and with inoise8() at each point
+static void profile_row_noise(int size) {
+    uint8_t row[NOISE_CHECK_LEN];
+    uint8_t volatile sink = 0;  // keeps the compiler from dropping the loops
+
+    unsigned long start_us = micros();
+    for (int i = 0; i < size; i++) {
+        inoise8_row(i * 40, 0, 40, 0, row, size);
+        sink = sink + row[size - 1];
+    }
+    unsigned long row_us = micros() - start_us;
+
+    start_us = micros();
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            row[j] = inoise8(i * 40, j * 40, 0);
+        }
+        sink = sink + row[size - 1];
+    }
+    unsigned long point_us = micros() - start_us;
+
+    print("Noise field %dx%d: inoise8_row %lu us, inoise8 %lu us\n", size, size, row_us, point_us);
+}
+#endif
+
+// Checks inoise8_row() against FastLED's inoise8() on rows at random coordinates and scales, which cross lattice
+// cells and wrap around. inoise8_row() copies FastLED's noise internals, so this catches a FastLED update that
+// changes them. Returns true if every point matches. With PROFILE_AUDIO, also prints the time to fill 16x16 and 64x64
+// fields both ways.
+static bool check_row_noise() {
+    uint8_t row[NOISE_CHECK_LEN];
+    int mismatches = 0;
+    for (int r = 0; r < NOISE_CHECK_ROWS; r++) {
+        uint16_t x = random16();
+        uint16_t y = random16();
+        uint16_t z = random16();
+        uint16_t y_step = 1 + random16(512);
+        inoise8_row(x, y, y_step, z, row, NOISE_CHECK_LEN);
+        for (int n = 0; n < NOISE_CHECK_LEN; n++) {
+            mismatches += (row[n] != inoise8(x, uint16_t(y + n * y_step), z));
+        }
+    }
+    if (mismatches > 0) {
+        print("WARNING: inoise8_row() differs from inoise8() at %d of %d points, using inoise8()\n", mismatches,
+              NOISE_CHECK_ROWS * NOISE_CHECK_LEN);
+    }
+
+#ifdef PROFILE_AUDIO
+    profile_row_noise(16);
+    profile_row_noise(64);
+#endif
+    return mismatches == 0;
+}
 
 // Constructor for base class, called by all subclasses
 LEDAudioPattern::LEDAudioPattern(LEDPanel *lp) {
@@ -20,7 +198,7 @@ uint16_t LEDNoisePattern::_target_y = _y;
 uint16_t LEDNoisePattern::_speed = 1;
 uint16_t LEDNoisePattern::_scale = 40;
 uint16_t LEDNoisePattern::_target_scale = _scale;
-uint8_t LEDNoisePattern::_noise[GRID_H][GRID_W] = {0};
+uint8_t LEDNoisePattern::_noise[NOISE_GRID_SIZE][NOISE_GRID_SIZE] = {0};
 
 // Fill the x/y array of 8-bit noise values using the inoise8 function. From FastLED.
 void LEDNoisePattern::_fill_noise8() {
@@ -29,20 +207,30 @@ void LEDNoisePattern::_fill_noise8() {
     // The amount of data smoothing we're doing depends on "speed".
     uint8_t dataSmoothing = 0;
 
-    _scale = int(round((_target_scale * 0.3) + (_scale * 0.7)));  // slowly move toward the new target_scale
-    _x = int(round((_target_x * 0.3) + (_x * 0.7)));              // slowly move toward the new target_x
-    _y = int(round((_target_y * 0.3) + (_y * 0.7)));              // slowly move toward the new target_y
+    _scale = (_target_scale * 3 + _scale * 7 + 5) / 10;  // slowly move toward the new target_scale
+    _x = (_target_x * 3 + _x * 7 + 5) / 10;              // slowly move toward the new target_x
+    _y = (_target_y * 3 + _y * 7 + 5) / 10;              // slowly move toward the new target_y
 
     if (_speed < 50) {
         dataSmoothing = 200 - (_speed * 4);
     }
 
-    for (int i = 0; i < GRID_W; i++) {
-        int ioffset = _scale * (i - int(GRID_W / 2));  // center the scale shift
-        for (int j = 0; j < GRID_H; j++) {
-            int joffset = _scale * (j - int(GRID_H / 2));  // center the scale shift
+    static const bool row_noise_ok = check_row_noise();  // checked once, the first time the noise is filled
+
+    uint8_t row[NOISE_GRID_SIZE];
+    for (int i = 0; i < NOISE_GRID_SIZE; i++) {
+        int ioffset = _scale * (i - int(NOISE_GRID_SIZE / 2));  // center the scale shift
+        int joffset = _scale * (0 - int(NOISE_GRID_SIZE / 2));  // offset of the first point in the row
+        if (row_noise_ok) {
+            inoise8_row(_x + ioffset, _y + joffset, _scale, _z, row, NOISE_GRID_SIZE);
+        } else {
+            for (int j = 0; j < NOISE_GRID_SIZE; j++) {
+                row[j] = inoise8(_x + ioffset, _y + joffset + j * _scale, _z);
+            }
+        }
 
-            uint8_t data = inoise8(_x + ioffset, _y + joffset, _z);
+        for (int j = 0; j < NOISE_GRID_SIZE; j++) {
+            uint8_t data = row[j];
 
             // The range of the inoise8 function is roughly 16-238.
             // These two operations expand those values out to roughly 0..255
@@ -57,6 +245,12 @@ void LEDNoisePattern::_fill_noise8() {
             }
 
             _noise[i][j] = data;
+
+            // brighten up, as the color palette itself often contains the
+            // light/dark dynamic range desired
+            if (i < GRID_W && j < GRID_H) {
+                _brightness[j][i] = (data > 127) ? 255 : dim8_raw(data * 2);
+            }
         }
     }
 
@@ -69,30 +263,23 @@ void LEDNoisePattern::_fill_noise8() {
 
 // Sets LEDs based on noise grid and current palette. From FastLED.
 void LEDNoisePattern::_map_noise_to_leds_using_palette() {
-    for (int i = 0; i < GRID_W; i++) {
-        for (int j = 0; j < GRID_H; j++) {
+    const CRGB *palette = _lp->get_palette_lut();
+
+    for (int j = 0; j < GRID_H; j++) {
+        for (int i = 0; i < GRID_W; i++) {
             // We use the value at the (i,j) coordinate in the noise
             // array for our brightness, and the flipped value from (j,i)
             // for our pixel's index into the color palette.
 
             uint8_t index = _noise[j][i];
-            uint8_t bri = _noise[i][j];
 
             // // if this palette is a 'loop', add a slowly-changing base value
             // if( colorLoop) {
             //   index += ihue;
             // }
 
-            // brighten up, as the color palette itself often contains the
-            // light/dark dynamic range desired
-            if (bri > 127) {
-                bri = 255;
-            } else {
-                bri = dim8_raw(bri * 2);
-            }
-
-            CRGB color = ColorFromPalette(_lp->get_palette(), index, bri);
-            _lp->set_xy(i, j, color);
+            CRGB color = scale_palette_color(palette[index], _brightness[j][i]);
+            _lp->set_xy_unchecked(i, j, color);
         }
     }
 
@@ -100,13 +287,23 @@ void LEDNoisePattern::_map_noise_to_leds_using_palette() {
 }
 
 // Generates a simplex noise pattern of LEDs. Based on FastLED implementation.
-void LEDNoisePattern::set_leds(int *intensity, double tempo) {
+void LEDNoisePattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    // Speed up the noise on each beat, slowing back down over the course of the beat
+    if (tempo > 0) {
+        double pulse = 1 - beat_phase;
+        _speed = 1 + int(round(pulse * pulse * pulse * NOISE_BEAT_SPEED));
+    } else {
+        _speed = 1;
+    }
+
     _fill_noise8();
     _map_noise_to_leds_using_palette();
 }
 
 // Generates vertical bar pattern, with peaks that decay over time. Based on ESP32 FFT VU code.
-void LEDBarsPattern::set_leds(int *intensity, double tempo) {
+void LEDBarsPattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    const CRGB *palette = _lp->get_palette_lut();
+
     for (int bar_x = 0; bar_x < GRID_W; bar_x++) {
         int max_y = int(round((float(intensity[bar_x]) / 255) * GRID_H));  // scale the intensity by the grid height
         max_y = constrain(max_y, 0, GRID_H - 1);
@@ -117,16 +314,15 @@ void LEDBarsPattern::set_leds(int *intensity, double tempo) {
         }
 
         // Light up or darken each grid element
+        CRGB color = palette[int(round(float(bar_x) / GRID_W * 255))];
         for (int bar_y = 0; bar_y < GRID_H; bar_y++) {
             if (bar_y < max_y) {
-                int color_index = int(round(float(bar_x) / GRID_W * 255));
-                CRGB color = ColorFromPalette(_lp->get_palette(), color_index, 255, _lp->get_blending());
-                _lp->set_xy(bar_x, bar_y, color);
+                _lp->set_xy_unchecked(bar_x, bar_y, color);
             } else {
-                _lp->set_xy(bar_x, bar_y, CRGB::Black);
+                _lp->set_xy_unchecked(bar_x, bar_y, CRGB::Black);
             }
         }
-        _lp->set_xy(bar_x, _peaks[bar_x], CRGB::White);  // light up the peak
+        _lp->set_xy_unchecked(bar_x, _peaks[bar_x], CRGB::White);  // light up the peak
 
         if (_counter % PEAK_DECAY_RATE == 0) {  // every X frames, shift peak down
             if (_peaks[bar_x] > 0) {
@@ -138,7 +334,9 @@ void LEDBarsPattern::set_leds(int *intensity, double tempo) {
 }
 
 // Generates vertical peaks that decay and change color over time. Based on ESP32 FFT VU code.
-void LEDOutrunBarsPattern::set_leds(int *intensity, double tempo) {
+void LEDOutrunBarsPattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    const CRGB *palette = _lp->get_palette_lut();
+
     for (int bar_x = 0; bar_x < GRID_W; bar_x++) {
         int max_y = int(round((float(intensity[bar_x]) / 255) * GRID_H));  // scale the intensity by the grid height
         max_y = constrain(max_y, 0, GRID_H - 1);
@@ -150,12 +348,12 @@ void LEDOutrunBarsPattern::set_leds(int *intensity, double tempo) {
 
         // Only light up the peak
         for (int bar_y = 0; bar_y < GRID_H; bar_y++) {
-            _lp->set_xy(bar_x, bar_y, CRGB::Black);
+            _lp->set_xy_unchecked(bar_x, bar_y, CRGB::Black);
         }
         int color_index = int(round(float(_peaks[bar_x]) / GRID_H * 255));
-        CRGB color = ColorFromPalette(_lp->get_palette(), color_index, 255, _lp->get_blending());
+        CRGB color = palette[color_index];
 
-        _lp->set_xy(bar_x, _peaks[bar_x], color);  // light up the peak
+        _lp->set_xy_unchecked(bar_x, _peaks[bar_x], color);  // light up the peak
 
         if (_counter % PEAK_DECAY_RATE == 0) {  // every X frames, shift peak down
             if (_peaks[bar_x] > 0) {
@@ -167,7 +365,9 @@ void LEDOutrunBarsPattern::set_leds(int *intensity, double tempo) {
 }
 
 // Generates centered symmetric vertical bar pattern. Based on ESP32 FFT VU code.
-void LEDCenterBarsPattern::set_leds(int *intensity, double tempo) {
+void LEDCenterBarsPattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    const CRGB *palette = _lp->get_palette_lut();
+
     for (int bar_x = 0; bar_x < GRID_W; bar_x++) {
         int max_y = int(round((float(intensity[bar_x]) / 255) * GRID_H));  // scale the intensity by the grid height
         max_y = constrain(max_y, 0, GRID_H - 1);
@@ -178,99 +378,77 @@ void LEDCenterBarsPattern::set_leds(int *intensity, double tempo) {
         for (int bar_y = 0; bar_y < GRID_H; bar_y++) {
             if (bar_y >= y_start && bar_y <= (y_start + max_y)) {
                 int color_index = constrain((bar_y - y_start) * (255 / max_y), 0, 255);
-                CRGB color = ColorFromPalette(_lp->get_palette(), color_index, 255, _lp->get_blending());
-
-                _lp->set_xy(bar_x, bar_y, color);
+                _lp->set_xy_unchecked(bar_x, bar_y, palette[color_index]);
             } else {
-                _lp->set_xy(bar_x, bar_y, CRGB::Black);
+                _lp->set_xy_unchecked(bar_x, bar_y, CRGB::Black);
             }
         }
     }
 }
 
 // Generates side-scrolling spectrogram. Based on ESP32 FFT VU code.
-void LEDWaterfallPattern::set_leds(int *intensity, double tempo) {
-    for (int bar_y = 0; bar_y < GRID_H; bar_y++) {
-        // Draw right line
-        //_lp->set_xy(GRID_W - 1, bar_y, CHSV(constrain(map(intensity[bar_y], 0, 255, 160, 0), 0, 160), 255, 255));
-        _lp->set_xy(GRID_W - 1, bar_y, ColorFromPalette(_lp->get_palette(), intensity[bar_y], 255, _lp->get_blending()));
-        //_lp->set_xy(GRID_W - 1, bar_y, CHSV(constrain(intensity[bar_y], rgb2hsv_approximate(_lp->get_palette()[0]).h, rgb2hsv_approximate(_lp->get_palette()[15]).h), 255, 255));
-
-        // Move screen left starting at 2nd row from left
-        if (bar_y == GRID_H - 1) {  // do this on the last cycle
-            for (int bar_x = 1; bar_x < GRID_W; bar_x++) {
-                for (int y = 0; y < GRID_H; y++) {
-                    int pixelIndexX = _lp->grid_to_idx(bar_x - 1, y);
-                    int pixelIndex = _lp->grid_to_idx(bar_x, y);
-                    _lp->set(pixelIndexX, _lp->get(pixelIndex));
-                    //_lp->leds[pixelIndexX] = _lp->leds[pixelIndex];
-                }
-            }
+void LEDWaterfallPattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    const CRGB *palette = _lp->get_palette_lut();
+
+    // Add this frame to the running average in the newest column
+    _count++;
+    for (int y = 0; y < GRID_H; y++) {
+        _sum[y] += uint8_t(intensity[y]);
+        _history[_newest][y] = _sum[y] / _count;
+    }
+
+    // Draw the columns from the oldest on the left to the newest on the right
+    int col = _newest;
+    for (int x = GRID_W - 1; x >= 0; x--) {
+        for (int y = 0; y < GRID_H; y++) {
+            _lp->set_xy_unchecked(x, y, palette[_history[col][y]]);
         }
+        col = (col == 0) ? GRID_W - 1 : col - 1;
+    }
+
+    // Once the newest column has been averaged over enough frames, scroll by starting a new one over the oldest
+    if (_count >= SCROLL_AVG_FACTOR) {
+        _newest = (_newest == GRID_W - 1) ? 0 : _newest + 1;
+        memset(_sum, 0, sizeof(_sum));
+        _count = 0;
     }
 }
 
-// Generates left-right symmetric serpentine grid pattern that illuminates and fades over time.
-void LEDSymSnakeGridPattern::set_leds(int *intensity, double tempo) {
-    // Left half of array
+// Constructor, calculates the snake path and color/brightness tables
+LEDSymSnakeGridPattern::LEDSymSnakeGridPattern(LEDPanel *lp) : LEDAudioPattern(lp) {
+    // Left half of array, snaking up from the bottom center, and the right half mirroring it
     /*
-     * 0: 3 -> 0     (width * i + width/2 - 1)::-1
-     * 1: 15 -> 12   (width * (i + 1) - 1)::-1
-     * 2: 19 -> 16   (width * i + width/2 - 1)::-1
-     * 3: 31 -> 28   (width * (i + 1) - 1)::-1
-     * 4: 35 -> 32   (width * i + width/2 - 1)::-1
-     * 5: 47 -> 44   (width * (i + 1) - 1)::-1
-     * 6: 51 -> 48   (width * i + width/2 - 1)::-1
-     * 7: 63 -> 60   (width * (i + 1) - 1)::-1
+     * row 0: x = width/2 - 1 -> 0          x = width/2 -> width - 1
+     * row 1: x = 0 -> width/2 - 1          x = width - 1 -> width/2
+     * row 2: x = width/2 - 1 -> 0          x = width/2 -> width - 1
+     * ...
      */
-
+    int color_step = int(round(255.0 / (NUM_LEDS / 2.0)));
     int curr_index = 0;
-    int color_index = 0;
     for (int i = 0; i < GRID_H; i++) {
-        if (i % 2 == 0) {
-            for (int j = 0; j < GRID_W / 2; j++) {
-                _lp->set(GRID_W * i + GRID_W / 2 - 1 - j, ColorFromPalette(_lp->get_palette(), int(color_index), pgm_read_byte(&GAMMA8[int(intensity[curr_index] * 255.0 / double(BRIGHT_LEVELS))]), _lp->get_blending()));
-                color_index += int(round(255.0 / (NUM_LEDS / 2.0)));
-                curr_index += 1;
-            }
-        } else {
-            for (int j = 0; j < GRID_W / 2; j++) {
-                _lp->set(GRID_W * (i + 1) - 1 - j, ColorFromPalette(_lp->get_palette(), int(color_index), pgm_read_byte(&GAMMA8[int(intensity[curr_index] * 255.0 / double(BRIGHT_LEVELS))]), _lp->get_blending()));
-                color_index += int(round(255.0 / (NUM_LEDS / 2.0)));
-                curr_index += 1;
-            }
+        for (int j = 0; j < GRID_W / 2; j++) {
+            int left_x = (i % 2 == 0) ? GRID_W / 2 - 1 - j : j;
+            _left_idx[curr_index] = _lp->grid_to_idx(left_x, i);
+            _right_idx[curr_index] = _lp->grid_to_idx(GRID_W - 1 - left_x, i);
+            _color_index[curr_index] = uint8_t(curr_index * color_step);
+            curr_index++;
         }
     }
 
-    // Right half of array
-    /*
-     * 0: 4 -> 7     (width * i + width/2)::+1
-     * 1: 8 -> 11    (width * i)::+1
-     * 2: 20 -> 23   (width * i + width/2)::+1
-     * 3: 24 -> 27   (width * i)::+1
-     * 4: 36 -> 39   (width * i + width/2)::+1
-     * 5: 40 -> 43   (width * i)::+1
-     * 6: 52 -> 55   (width * i + width/2)::+1
-     * 7: 56 -> 59   (width * i)::+1
-     */
-    curr_index = 0;
-    color_index = 0;
-    CRGB curr_color;
-    for (int i = 0; i < GRID_H; i++) {
-        if (i % 2 == 0) {
-            for (int j = 0; j < GRID_W / 2; j++) {
-                _lp->set(GRID_W * i + GRID_W / 2 + j, ColorFromPalette(_lp->get_palette(), int(color_index), pgm_read_byte(&GAMMA8[int(intensity[curr_index] * 255.0 / double(BRIGHT_LEVELS))]), _lp->get_blending()));
-                // TODO: Pull color from palette first at intensity[curr_index]; _then_ apply gamma to adjust.
-                // TODO: Use same gammas for RGB that are used on RaspPi
-                color_index += int(round(255.0 / (NUM_LEDS / 2.0)));
-                curr_index += 1;
-            }
-        } else {
-            for (int j = 0; j < GRID_W / 2; j++) {
-                _lp->set(GRID_W * i + j, ColorFromPalette(_lp->get_palette(), int(color_index), pgm_read_byte(&GAMMA8[int(intensity[curr_index] * 255.0 / double(BRIGHT_LEVELS))]), _lp->get_blending()));
-                color_index += int(round(255.0 / (NUM_LEDS / 2.0)));
-                curr_index += 1;
-            }
-        }
+    for (int i = 0; i <= BRIGHT_LEVELS; i++) {
+        _brightness[i] = pgm_read_byte(&GAMMA8[int(i * 255.0 / double(BRIGHT_LEVELS))]);
+    }
+}
+
+// Generates left-right symmetric serpentine grid pattern that illuminates and fades over time.
+void LEDSymSnakeGridPattern::set_leds(int *intensity, double tempo, double beat_phase) {
+    const CRGB *palette = _lp->get_palette_lut();
+
+    // TODO: Pull color from palette first at intensity[curr_index]; _then_ apply gamma to adjust.
+    // TODO: Use same gammas for RGB that are used on RaspPi
+    for (int i = 0; i < NUM_LEDS / 2; i++) {
+        CRGB color = scale_palette_color(palette[_color_index[i]], _brightness[intensity[i]]);
+        _lp->set(_left_idx[i], color);
+        _lp->set(_right_idx[i], color);
     }
 }
@@ -6,6 +6,8 @@
 #include "Constants.h"
 #include "FastLED.h"
 
+#define NOISE_GRID_SIZE (GRID_W > GRID_H ? GRID_W : GRID_H)
+
 // Forward declaration
 class LEDPanel;
 
@@ -19,9 +21,10 @@ class LEDAudioPattern {
     virtual ~LEDAudioPattern();
 
     // Abstract method to be implemented by all subclasses
-    // Sets the LED intensity values for the given array. Accepts a music tempo parameter that can be used
-    // to alter the noise pattern.
-    virtual void set_leds(int *intensity, double tempo) = 0;
+    // Sets the LED intensity values for the given array. Accepts the music tempo (in beats per minute, 0 if
+    // unknown) and the position within the current beat (from 0 on the beat up to 1), which can be used to
+    // alter the pattern in time with the music.
+    virtual void set_leds(int *intensity, double tempo, double beat_phase) = 0;
 
    protected:
     LEDPanel *_lp;  // pointer to LED panel object whose pixels will be updated
@@ -32,7 +35,7 @@ class LEDAudioPattern {
 class LEDNoisePattern : public LEDAudioPattern {
    public:
     LEDNoisePattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
 
    private:
     // Fill the _noise array with simplex noise values
@@ -66,15 +69,20 @@ class LEDNoisePattern : public LEDAudioPattern {
     static uint16_t _scale;  // scale is set dynamically once we've started up
     static uint16_t _target_scale;  // used when adjusting scale dynamically
 
-    // This is the array that we keep our computed noise values in
-    static uint8_t _noise[GRID_H][GRID_W];
+    // This is the array that we keep our computed noise values in. It is square because the palette index
+    // is read from the transposed coordinate.
+    static uint8_t _noise[NOISE_GRID_SIZE][NOISE_GRID_SIZE];
+
+    // Brightness of each LED, derived from _noise[x][y] as it is filled and stored row by row like the palette
+    // index _noise[y][x], so that both are read in order when mapping to the LEDs
+    uint8_t _brightness[GRID_H][GRID_W] = {{0}};
 };
 
 // Creates a vertical filled bar pattern
 class LEDBarsPattern : public LEDAudioPattern {
    public:
     LEDBarsPattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
 
    private:
     uint8_t _peaks[GRID_W] = {0};
@@ -85,7 +93,7 @@ class LEDBarsPattern : public LEDAudioPattern {
 class LEDOutrunBarsPattern : public LEDAudioPattern {
    public:
     LEDOutrunBarsPattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
 
    private:
     uint8_t _peaks[GRID_W] = {0};
@@ -96,21 +104,37 @@ class LEDOutrunBarsPattern : public LEDAudioPattern {
 class LEDCenterBarsPattern : public LEDAudioPattern {
    public:
     LEDCenterBarsPattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
 };
 
-// Creates a side-scrolling waterfall pattern, similar to a spectrogram display
+// Creates a side-scrolling waterfall pattern, similar to a spectrogram display. Each column is the average of
+// SCROLL_AVG_FACTOR frames, with the newest column on the right updating as it is averaged. Columns are kept in
+// a ring buffer, so scrolling only moves the position of the oldest column rather than the history itself.
 class LEDWaterfallPattern : public LEDAudioPattern {
    public:
     LEDWaterfallPattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
+
+   private:
+    uint8_t _history[GRID_W][GRID_H] = {{0}};  // ring buffer of averaged intensities, one column per scroll step
+    int _newest = 0;                           // column of _history being averaged
+    uint16_t _sum[GRID_H] = {0};               // sum of the intensities averaged into the newest column so far
+    int _count = 0;                            // number of frames summed into _sum
 };
 
 // Creates a left/right symmetric serpentine grid pattern that illuminates and fades over time
 class LEDSymSnakeGridPattern : public LEDAudioPattern {
    public:
-    LEDSymSnakeGridPattern(LEDPanel *lp) : LEDAudioPattern(lp){};
-    void set_leds(int *intensity, double tempo) override;
+    LEDSymSnakeGridPattern(LEDPanel *lp);
+    void set_leds(int *intensity, double tempo, double beat_phase) override;
+
+   private:
+    // Tables calculated once in the constructor, indexed by position along the snake
+    uint16_t _left_idx[NUM_LEDS / 2];   // LED index in the left half, snaking up from the bottom center
+    uint16_t _right_idx[NUM_LEDS / 2];  // LED index of the mirror image in the right half
+    uint8_t _color_index[NUM_LEDS / 2];  // palette index, ramping across the whole palette
+
+    uint8_t _brightness[BRIGHT_LEVELS + 1];  // gamma corrected brightness for each intensity
 };
 
 #endif  // _LEDAUDIOPATTERN_H
\ No newline at end of file
@@ -3,68 +3,280 @@
 #include "LEDAudioPattern.h"
 #include "Utils.h"
 
-// Default constructor
-LEDPanel::LEDPanel(int width, int height, int num_leds, int led_pin, uint8_t brightness, bool serpentine, first_pixel_location_t first_pixel) {
-    if (!serpentine || first_pixel != BOTTOM_LEFT) {
-        print("Error: Unsupported LEDPanel config!\n");
+// Default constructor, for a single panel
+LEDPanel::LEDPanel(int width, int height, int num_leds, int led_pin, uint8_t brightness, bool serpentine, first_pixel_location_t first_pixel, bool column_major)
+    : LEDPanel(width, height, NULL, 0, brightness) {
+    tile_t tile = {led_pin, 0, 0, width, min(height, num_leds / width), serpentine, first_pixel, column_major};
+    _add_tile(tile);
+}
+
+// Tiled constructor
+LEDPanel::LEDPanel(int width, int height, const tile_t *tiles, int num_tiles, uint8_t brightness) {
+    if (width * height > NUM_LEDS) {
+        print("Error: LEDPanel is larger than NUM_LEDS!\n");
+        height = NUM_LEDS / width;
     }
 
     this->_w = width;
     this->_h = height;
-    this->_num_leds = num_leds;
-    this->_led_pin = led_pin;
     this->_brightness = brightness;
-    this->_serpentine = serpentine;
-    this->_first_pixel = first_pixel;
     this->_audio_pattern = NULL;
+
+    for (int i = 0; i < _w * _h; i++) {
+        _xy_table[i] = NUM_LEDS;  // until a panel covers it
+    }
+
+    // Start each channel at a different point in its dithering cycle, so that LEDs at the same level don't all
+    // step up on the same frame
+    for (int i = 0; i < NUM_LEDS * 3; i++) {
+        _dither_error[i] = uint8_t(i * 167);
+    }
+
+    for (int i = 0; i < num_tiles; i++) {
+        _add_tile(tiles[i]);
+    }
+}
+
+bool LEDPanel::_add_tile(const tile_t &tile) {
+    if (_num_tiles >= PANEL_MAX_TILES) {
+        print("Error: too many LED panels, max is %d!\n", PANEL_MAX_TILES);
+        return false;
+    }
+    if (tile.x < 0 || tile.y < 0 || tile.x + tile.width > _w || tile.y + tile.height > _h || _num_leds + tile.width * tile.height > NUM_LEDS) {
+        print("Error: LED panel on pin %d does not fit the canvas!\n", tile.led_pin);
+        return false;
+    }
+
+    _tiles[_num_tiles] = tile;
+    _tile_offsets[_num_tiles] = _num_leds;
+    _build_xy_table(tile, _num_leds);
+
+    _num_leds += tile.width * tile.height;
+    _num_tiles++;
+    return true;
+}
+
+// Walks the panel's LEDs in the order they are wired, working out the XY coordinate of each one
+void LEDPanel::_build_xy_table(const tile_t &tile, int offset) {
+    int run_length = tile.column_major ? tile.height : tile.width;  // number of LEDs before the strip turns
+
+    for (int idx = 0; idx < tile.width * tile.height; idx++) {
+        int run = idx / run_length;
+        int pos = idx % run_length;
+        if (tile.serpentine && (run % 2 == 1)) {  // odd runs go back the other way
+            pos = run_length - 1 - pos;
+        }
+
+        // Coordinates relative to the first pixel, then flipped so that (0, 0) is the bottom left
+        int x = tile.column_major ? run : pos;
+        int y = tile.column_major ? pos : run;
+        if (tile.first_pixel == BOTTOM_RIGHT || tile.first_pixel == TOP_RIGHT) {
+            x = tile.width - 1 - x;
+        }
+        if (tile.first_pixel == TOP_LEFT || tile.first_pixel == TOP_RIGHT) {
+            y = tile.height - 1 - y;
+        }
+
+        _xy_table[(tile.y + y) * _w + (tile.x + x)] = offset + idx;
+    }
 }
 
 LEDPanel::~LEDPanel() {
 }
 
 void LEDPanel::init() {
+    _ready_mutex = xSemaphoreCreateMutex();
+    _output_mutex = xSemaphoreCreateMutex();
+
     // LED Setup
-    FastLED.addLeds<WS2812, PIN_LED_CONTROL, GRB>(_leds, _num_leds);
+    for (int i = 0; i < _num_tiles; i++) {
+        if (!_add_leds(_tiles[i].led_pin, &_front[_tile_offsets[i]], _tiles[i].width * _tiles[i].height)) {
+            print("Error: unsupported LED pin %d!\n", _tiles[i].led_pin);
+        }
+    }
+#ifdef LED_NO_DITHER
     FastLED.setBrightness(_brightness);
+#else
+    FastLED.setBrightness(255);  // brightness is applied by show(), which does its own dithering
+    FastLED.setDither(DISABLE_DITHER);
+#endif
     FastLED.clear();
     FastLED.show();
     _curr_palette = Sunset_Real_gp;
     _audio_pattern = new LEDNoisePattern(this);
 }
 
+void LEDPanel::clear() {
+    fill_solid(_leds, NUM_LEDS + 1, CRGB::Black);
+    _dirty = true;
+}
+
+// Most static frames are caught by the dirty flag alone. A frame can also be drawn over and end up the same as the
+// last one (e.g. art blended toward a steady state with an overlay on top), so dirty frames are compared too.
+bool LEDPanel::publish() {
+    if (!_dirty) {
+        return false;
+    }
+    _dirty = false;
+
+    xSemaphoreTake(_ready_mutex, portMAX_DELAY);
+    bool changed = (_stats.frames_published == 0) || (memcmp(_ready, _leds, _num_leds * sizeof(CRGB)) != 0);
+    if (changed) {
+        memcpy(_ready, _leds, _num_leds * sizeof(CRGB));
+        _ready_us = micros();
+        _stats.frames_published++;
+    }
+    xSemaphoreGive(_ready_mutex);
+
+    return changed;
+}
+
+// Scales 8-bit channels to Q8 at the given brightness, matching the average level of FastLED's scale8(). Returns
+// true if any channel has a fraction left to dither.
+static bool scale_channels(const uint8_t *in, uint16_t *out, int num_channels, uint8_t brightness) {
+    uint16_t scale = uint16_t(brightness) + 1;
+    uint8_t fraction = 0;
+    for (int i = 0; i < num_channels; i++) {
+        out[i] = in[i] * scale;
+        fraction |= uint8_t(out[i]);
+    }
+    return fraction != 0;
+}
+
+// Rounds Q8 channels down to 8 bits, carrying each channel's remainder over to the next frame so that its level
+// averages out to the Q8 value over time. The largest Q8 value (255 * 256) plus the largest remainder still fits
+// in 16 bits.
+static void dither_channels(const uint16_t *in, uint8_t *error, uint8_t *out, int num_channels) {
+    for (int i = 0; i < num_channels; i++) {
+        uint16_t val = in[i] + error[i];
+        out[i] = val >> 8;
+        error[i] = uint8_t(val);
+    }
+}
+
+// Rounds Q8 channels to the nearest 8-bit level, for a frame that is no longer dithered. The largest Q8 value plus
+// one half still rounds to 255.
+static void round_channels(const uint16_t *in, uint8_t *out, int num_channels) {
+    for (int i = 0; i < num_channels; i++) {
+        out[i] = (in[i] + 128) >> 8;
+    }
+}
+
+bool LEDPanel::show() {
+    xSemaphoreTake(_output_mutex, portMAX_DELAY);  // FastLED must only send one frame at a time
+
+    xSemaphoreTake(_ready_mutex, portMAX_DELAY);
+    bool new_frame = (_stats.frames_published != _last_shown);
+    if (!new_frame && !_dithering) {  // nothing new to show
+        xSemaphoreGive(_ready_mutex);
+        xSemaphoreGive(_output_mutex);
+        return false;
+    }
+    unsigned long publish_us = _ready_us;
+    if (new_frame) {
+#ifdef LED_NO_DITHER
+        memcpy(_front, _ready, _num_leds * sizeof(CRGB));
+#else
+        _dithering = scale_channels(_ready[0].raw, _scaled, _num_leds * 3, _brightness);
+        _dither_resends = 0;
+#endif
+        _last_shown = _stats.frames_published;
+    }
+    xSemaphoreGive(_ready_mutex);
+
+#ifndef LED_NO_DITHER
+    if (!new_frame && ++_dither_resends >= LED_DITHER_RESENDS) {
+        // Stop re-sending a frame that has stayed the same for a while, and leave it at its nearest levels
+        round_channels(_scaled, _front[0].raw, _num_leds * 3);
+        _dithering = false;
+    } else {
+        dither_channels(_scaled, _dither_error, _front[0].raw, _num_leds * 3);
+    }
+#endif
+
+    unsigned long start_us = micros();
+    FastLED.show();
+    unsigned long show_us = micros() - start_us;
+
+    if (!new_frame) {  // only re-sent for dithering
+        xSemaphoreGive(_output_mutex);
+        return false;
+    }
+
+    xSemaphoreTake(_ready_mutex, portMAX_DELAY);
+    _stats.frames_shown++;
+    _stats.publish_us = publish_us;
+    _stats.show_us = show_us;
+    xSemaphoreGive(_ready_mutex);
+
+    xSemaphoreGive(_output_mutex);
+    return true;
+}
+
+bool LEDPanel::is_dithering() {
+    return _dithering;
+}
+
+LEDPanel::output_stats_t LEDPanel::get_output_stats() {
+    xSemaphoreTake(_ready_mutex, portMAX_DELAY);
+    output_stats_t stats = _stats;
+    xSemaphoreGive(_ready_mutex);
+
+    return stats;
+}
+
+// Output-capable GPIOs, excluding 6-11 which are used for flash
+#define LED_PIN_CASE(pin)                                  \
+    case pin:                                              \
+        FastLED.addLeds<WS2812, pin, GRB>(leds, num_leds); \
+        return true;
+
+bool LEDPanel::_add_leds(int led_pin, CRGB *leds, int num_leds) {
+    switch (led_pin) {
+        LED_PIN_CASE(2)
+        LED_PIN_CASE(4)
+        LED_PIN_CASE(5)
+        LED_PIN_CASE(12)
+        LED_PIN_CASE(13)
+        LED_PIN_CASE(14)
+        LED_PIN_CASE(15)
+        LED_PIN_CASE(16)
+        LED_PIN_CASE(17)
+        LED_PIN_CASE(18)
+        LED_PIN_CASE(19)
+        LED_PIN_CASE(21)
+        LED_PIN_CASE(22)
+        LED_PIN_CASE(23)
+        LED_PIN_CASE(25)
+        LED_PIN_CASE(26)
+        LED_PIN_CASE(27)
+        LED_PIN_CASE(32)
+        LED_PIN_CASE(33)
+        default:
+            return false;
+    }
+}
+
 void LEDPanel::set(int idx, CRGB value) {
-    _leds[idx] = value;
+    _set_led(idx, value);
 }
 
 void LEDPanel::set_xy(int x, int y, CRGB value, bool start_top_left) {
     int idx = grid_to_idx(x, y, start_top_left);
-    if (idx >= 0 && idx < _num_leds) _leds[idx] = value;
+    if (idx >= 0 && idx < _num_leds) _set_led(idx, value);
 }
 
 int LEDPanel::grid_to_idx(int x, int y, bool start_top_left) {
     // Coordinate system starts with (0, 0) at the bottom left corner of grid.
-    // Assumes a serpentine grid with the first pixel at the bottom left corner.
-    // Even rows increment left->right, odd rows increment right->left.
-
-    // TODO: add support for non-serpentine and non-bottom-left-first-pixel orientations.
-    
-    int idx = 0;
-
-    if ((x >= GRID_W) || (y >= GRID_H)) {  // we are outside the grid
+    if ((x < 0) || (x >= _w) || (y < 0) || (y >= _h)) {  // we are outside the grid
         return -1;
     }
 
     if (start_top_left) {
-        y = GRID_H - 1 - y;
+        y = _h - 1 - y;
     }
 
-    if (y % 2 == 0) {
-        idx = GRID_W * y + x;
-    } else {
-        idx = GRID_W * y + (GRID_W - x - 1);
-    }
-
-    return idx;
+    return _xy_table[y * _w + x];
 }
 
 CRGB LEDPanel::get(int idx) {
@@ -73,6 +285,7 @@ CRGB LEDPanel::get(int idx) {
 
 CRGB LEDPanel::get_xy(int x, int y, bool start_top_left) {
     int idx = grid_to_idx(x, y, start_top_left);
+    if (idx < 0 || idx >= _num_leds) return CRGB::Black;
     return _leds[idx];
 }
 
@@ -108,12 +321,13 @@ void LEDPanel::set_audio_pattern(int mode) {
     }
 }
 
-void LEDPanel::display_audio(int *intensity, double tempo) {
-    _audio_pattern->set_leds(intensity, tempo);
+void LEDPanel::display_audio(int *intensity, double tempo, double beat_phase) {
+    _audio_pattern->set_leds(intensity, tempo, beat_phase);
 }
 
 void LEDPanel::set_palette(CRGBPalette16 palette) {
     this->_curr_palette = palette;
+    _palette_version++;
 }
 
 CRGBPalette16 LEDPanel::get_palette() {
@@ -130,6 +344,7 @@ CRGBPalette16 LEDPanel::get_target_palette() {
 
 void LEDPanel::set_blending(TBlendType blending) {
     this->_curr_blending = blending;
+    _palette_version++;
 }
 
 TBlendType LEDPanel::get_blending() {
@@ -137,7 +352,24 @@ TBlendType LEDPanel::get_blending() {
 }
 
 void LEDPanel::blend_palettes(int change_rate) {
-    nblendPaletteTowardPalette(this->_curr_palette, this->_target_palette, change_rate);
+    if (this->_curr_palette != this->_target_palette) {  // any difference means the blend will change something
+        nblendPaletteTowardPalette(this->_curr_palette, this->_target_palette, change_rate);
+        _palette_version++;
+    }
+}
+
+// The palette may be changed by another task while we expand it, in which case the version will have moved on
+// and we expand it again next time
+const CRGB *LEDPanel::get_palette_lut() {
+    uint32_t version = _palette_version;
+    if (version != _palette_lut_version) {
+        for (int i = 0; i < 256; i++) {
+            _palette_lut[i] = ColorFromPalette(_curr_palette, i, 255, _curr_blending);
+        }
+        _palette_lut_version = version;
+    }
+
+    return _palette_lut;
 }
 
 // Gradient palette "Sunset_Real_gp", originally from
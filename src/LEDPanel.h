@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 
+#include <atomic>
+
 #include "Constants.h"
 #include "FastLED.h"
 
@@ -12,6 +14,17 @@ class LEDAudioPattern;
 // The LEDPanel class describes a rectangular array of individually addressable RGB LEDs, along
 // with methods for setting individual LEDs. Many of the methods are wrappers around FastLED
 // functions which are used to control the LED strip, apply color palettes, and more.
+//
+// The array may be tiled from several physical panels, each on its own data pin, which together
+// form one logical canvas. Each panel's LEDs are stored contiguously and FastLED drives the panels
+// in parallel on separate RMT channels, so refresh time depends on the largest panel rather than
+// the total number of LEDs.
+//
+// Output is buffered so that drawing never waits for the LEDs to update. The set/get methods work on
+// a back buffer, which keeps its contents between frames. publish() copies a finished frame from the
+// back buffer to a ready buffer, and show() copies the ready buffer to the front buffer that FastLED
+// sends to the LEDs. Each copy is made under a short lock, so a frame is always shown whole, and the
+// transfer itself holds no lock that a renderer needs.
 class LEDPanel {
    public:
 
@@ -23,6 +36,26 @@ class LEDPanel {
         TOP_LEFT
     };
 
+    // Definition of one physical panel within a tiled canvas.
+    typedef struct tile {
+        int led_pin;                         // GPIO pin on the ESP32 used for this panel's LED control
+        int x;                               // position of the panel's bottom-left corner on the canvas
+        int y;
+        int width;                           // number of LEDs in the horizontal dimension
+        int height;                          // number of LEDs in the vertical dimension
+        bool serpentine;                     // see the single panel constructor
+        first_pixel_location_t first_pixel;  // see the single panel constructor
+        bool column_major;                   // see the single panel constructor
+    } tile_t;
+
+    // Frame output statistics.
+    typedef struct output_stats {
+        uint32_t frames_published;  // frames published by renderers
+        uint32_t frames_shown;      // frames sent to the LEDs, any others were replaced before they could be shown
+        unsigned long publish_us;   // time (from micros()) at which the last shown frame was published
+        unsigned long show_us;      // time taken to send the last shown frame to the LEDs
+    } output_stats_t;
+
     // Constructor, which accepts the following arguments:
     //      width: number of LEDs in the horizontal dimension
     //      height: number of LEDs in the vertical dimension
@@ -31,21 +64,58 @@ class LEDPanel {
     //      brightness: 0 to 255 value to indicate how brightly the LEDs should be illuminated
     //      serpentine: flag to define if the LEDs are physically arranged in a serpentine pattern
     //          where first row increments left->right, second row increments right->left, etc.
+    //          Otherwise every row increments in the same direction as the first (progressive).
     //      first_pixel: enum defining which corner of the array has the first pixel connected to the ESP32
+    //      column_major: flag to define if the LEDs are wired in columns rather than rows, as on a panel
+    //          rotated by 90 degrees
     //
-    // NOTE: serpentine and first_pixel are currently ignored. The default assumption is that the first pixel is in the 
-    //      bottom left and the LEDs are arranged in a serpentine orientation.
-    LEDPanel(int width, int height, int num_leds, int led_pin, uint8_t brightness, bool serpentine, first_pixel_location_t first_pixel);
+    // The layout is baked into a lookup table here, so XY accesses cost one table read.
+    LEDPanel(int width, int height, int num_leds, int led_pin, uint8_t brightness, bool serpentine, first_pixel_location_t first_pixel, bool column_major = false);
+
+    // Constructor for a canvas of width x height LEDs tiled from num_tiles physical panels (up to
+    // PANEL_MAX_TILES). Canvas positions not covered by a panel are ignored.
+    LEDPanel(int width, int height, const tile_t *tiles, int num_tiles, uint8_t brightness);
     ~LEDPanel();
 
     // Sets up FastLED with parameters from constructor.
     void init();
 
-    // Converts an XY coordinate to a linear LED index.
+    // Sets all LEDs in the back buffer to black.
+    void clear();
+
+    // Publishes the back buffer as the next frame to show. Call once a frame is complete, making sure no other
+    // task is writing to the back buffer at the same time. Never waits for the LEDs to update. Returns false
+    // (and publishes nothing) if the frame is the same as the last one published.
+    bool publish();
+
+    // Sends the most recently published frame to the LEDs, returning false if it has already been shown. Blocks
+    // for the transfer, during which other tasks are free to draw and publish the next frame.
+    //
+    // Frames are scaled to the panel brightness with 8 fractional bits, and the fraction is shown by temporal
+    // dithering: each LED carries its rounding error over to the next show. If is_dithering() returns true, the
+    // frame being shown has levels between the LED steps, and show() re-sends it (still returning false) so the
+    // dithering keeps running while no new frames are published. After LED_DITHER_RESENDS re-sends of the same
+    // frame, it is sent one last time rounded to the nearest levels and dithering stops until the next frame.
+    bool show();
+
+    // Returns true if the frame being shown needs to keep being re-sent for its dithering.
+    bool is_dithering();
+
+    // Returns the frame output statistics.
+    output_stats_t get_output_stats();
+
+    // Converts an XY coordinate to a linear LED index, returning -1 if the coordinate is outside the grid (or
+    // NUM_LEDS, which is never displayed, if no panel covers it).
     // By default an (x, y) coordinate of (0, 0) is considered to be the bottom-left corner of the array. 
     // This can be changed to the top-left corner by setting start_top_left to true.
     int grid_to_idx(int x, int y, bool start_top_left = false);
 
+    // Returns the linear LED indices of row y (with (0, 0) at the bottom left), ordered by x. For patterns that
+    // iterate whole rows; y is not checked.
+    const uint16_t *get_row(int y) {
+        return &_xy_table[y * _w];
+    }
+
     // Sets an LED value by linear array index.
     void set(int idx, CRGB value);
 
@@ -55,9 +125,18 @@ class LEDPanel {
     // Gets an LED value by linear array index.
     CRGB get(int idx);
 
-    // Gets an LED value by XY index. See grid_to_idx for XY coordinate assumption.
+    // Gets an LED value by XY index, or black if outside the grid. See grid_to_idx for XY coordinate assumption.
     CRGB get_xy(int x, int y, bool start_top_left = false);
 
+    // Sets/gets an LED value by XY index with (0, 0) at the bottom left and no bounds checks, for patterns that
+    // only touch coordinates inside the grid.
+    void set_xy_unchecked(int x, int y, CRGB value) {
+        _set_led(_xy_table[y * _w + x], value);
+    }
+    CRGB get_xy_unchecked(int x, int y) {
+        return _leds[_xy_table[y * _w + x]];
+    }
+
     // Copies LED data into the array provided.
     void copy_leds(CRGB *dest, int length);
 
@@ -65,6 +144,11 @@ class LEDPanel {
     void set_palette(CRGBPalette16 palette);
     CRGBPalette16 get_palette();
 
+    // Returns the current palette expanded to 256 full brightness colors with the current blend mode, i.e.
+    // entry i is ColorFromPalette(get_palette(), i, 255, get_blending()). Patterns index this rather than
+    // calling ColorFromPalette() per pixel. The table is only re-expanded after the palette changes.
+    const CRGB *get_palette_lut();
+
     // Sets/gets blend mode.
     void set_blending(TBlendType blending);
     TBlendType get_blending();
@@ -73,7 +157,7 @@ class LEDPanel {
     void set_audio_pattern(int mode);
 
     // Generates and displays an audio reactive pattern based on an array of LED intensity values.
-    void display_audio(int *intensity, double tempo = 0.0);
+    void display_audio(int *intensity, double tempo = 0.0, double beat_phase = 0.0);
 
     // Blends current color palette toward the target palette using a given change rate.
     // See FastLED nblendPaletteTowardPalette() for definition of change_rate.
@@ -86,24 +170,60 @@ class LEDPanel {
     CRGBPalette16 get_target_palette();
 
    private:
+    // Sets an LED in the back buffer, noting if it changed.
+    void _set_led(int idx, const CRGB &value) {
+        if (_leds[idx] != value) {
+            _leds[idx] = value;
+            _dirty = true;
+        }
+    }
+
+    // Adds a panel to the canvas, returning false if it does not fit.
+    bool _add_tile(const tile_t &tile);
+
+    // Fills the XY lookup table entries for a panel whose LEDs start at the given index.
+    void _build_xy_table(const tile_t &tile, int offset);
+
+    // Registers a panel's LEDs with FastLED, which needs the pin at compile time. Returns false if
+    // the pin is not supported.
+    bool _add_leds(int led_pin, CRGB *leds, int num_leds);
+
     LEDAudioPattern *_audio_pattern;        // pointer to an audio pattern object
 
     // Characteristics of the LED panel
     int _w;
     int _h;
-    first_pixel_location_t _first_pixel;
-    bool _serpentine;
-    int _led_pin;
     uint8_t _brightness;
-    int _num_leds;
-
-    CRGB _leds[NUM_LEDS];                     // array that stores LED values to be displayed
+    int _num_leds = 0;                        // total LEDs across all panels
+
+    tile_t _tiles[PANEL_MAX_TILES];           // physical panels making up the canvas
+    int _tile_offsets[PANEL_MAX_TILES];       // index of each panel's first LED in _leds
+    int _num_tiles = 0;
+
+    CRGB _leds[NUM_LEDS + 1];                 // back buffer that stores LED values to be displayed, plus one that is never
+                                              // displayed for canvas positions not covered by a panel
+    CRGB _ready[NUM_LEDS];                    // last frame published, waiting to be shown
+    CRGB _front[NUM_LEDS];                    // frame being sent to the LEDs, registered with FastLED
+    uint16_t _scaled[NUM_LEDS * 3];           // channels of the frame being shown, scaled to the panel brightness in Q8
+    uint8_t _dither_error[NUM_LEDS * 3];      // fraction of each channel carried over to the next show
+    bool _dithering = false;                  // true if any channel of _scaled has a fraction
+    int _dither_resends = 0;                  // times the frame being shown has been re-sent for dithering
+
+    SemaphoreHandle_t _ready_mutex;           // guards _ready and _stats
+    SemaphoreHandle_t _output_mutex;          // held while sending a frame to the LEDs
+    output_stats_t _stats = {0};
+    unsigned long _ready_us = 0;              // time at which _ready was published
+    uint32_t _last_shown = 0;                 // value of frames_published when the last frame was shown
+    bool _dirty = true;                       // true if the back buffer has been changed since the last publish
+    uint16_t _xy_table[NUM_LEDS];             // linear LED index for each XY coordinate, stored row by row from the bottom left
 
     CRGBPalette16 _curr_palette;              // current color palette
     CRGBPalette16 _target_palette;            // target palette that we will blend toward over time
     TBlendType _curr_blending = LINEARBLEND;  // type of blending to use between palettes
 
-    CRGB _colors_grid_wide[GRID_W * SCROLL_AVG_FACTOR][GRID_H] = {{CRGB::Black}};  // wider version of led array for use with the scrolling animation
+    CRGB _palette_lut[256];                          // current palette expanded by get_palette_lut()
+    std::atomic<uint32_t> _palette_version{1};       // incremented whenever the palette or blending changes
+    uint32_t _palette_lut_version = 0;               // palette version that _palette_lut was expanded from
 };
 
 DECLARE_GRADIENT_PALETTE(Sunset_Real_gp);   // declares color palette for use in default cases
@@ -1,8 +1,37 @@
 #include "MeanCut.h"
 
-#include "ArduinoSort.h"
 #include "Utils.h"
 
+#define MEAN_CUT_BINS 64       // histogram bins per channel, enough for the 6 bits of green
+#define MEAN_CUT_MAX_DEPTH 8   // limits the palette to 256 colors
+
+// RGB565 channel value to RGB888 value for each channel, as calculated by rgb565_to_rgb888()
+static uint8_t rgb565_decode[3][MEAN_CUT_BINS];
+static const int rgb565_bins[3] = {32, 64, 32};
+static const int rgb565_shift[3] = {11, 5, 0};
+
+// Returns the RGB565 value of the given channel of a pixel
+static inline uint8_t rgb565_channel(uint16_t rgb565_val, int channel) {
+    return (rgb565_val >> rgb565_shift[channel]) & (rgb565_bins[channel] - 1);
+}
+
+// Fills the rgb565_decode lookup table
+static void init_rgb565_decode() {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+
+    for (int i = 0; i < MEAN_CUT_BINS; i++) {
+        uint8_t rgb888_arr[3];
+        rgb565_to_rgb888(((i & 0x1F) << 11) | (i << 5) | (i & 0x1F), rgb888_arr);
+        for (int c = 0; c < 3; c++) {
+            rgb565_decode[c][i] = rgb888_arr[c];
+        }
+    }
+    initialized = true;
+}
+
 // Takes an rgb565 value and and a pointer to an array of 3 uint8_t values in which to store the rgb888 equivalent
 void rgb565_to_rgb888(uint16_t rgb565_val, uint8_t *rgb888_arr) {
     uint8_t r5 = (rgb565_val >> 11) & 0x1F;
@@ -14,33 +43,9 @@ void rgb565_to_rgb888(uint16_t rgb565_val, uint8_t *rgb888_arr) {
     rgb888_arr[2] = int(round((float(b5) / 31) * 255));
 }
 
-// Determine which color channel has the largest max/min difference
-int get_longest_dim(uint16_t *rgb565_arr, uint32_t length) {
-    uint8_t rgb888_arr[3];
-    uint8_t rgb_max_arr[3] = {0, 0, 0};
-    uint8_t rgb_min_arr[3] = {255, 255, 255};
-    uint8_t rgb_ranges[3];
-
-    // loop through all pixels
-    for (int i = 0; i < length; i++) {
-        rgb565_to_rgb888(rgb565_arr[i], rgb888_arr);  // decode current pixel into rgb888_arr
-
-        // loop through rgb components
-        for (int c = 0; c < 3; c++) {
-            if (rgb888_arr[c] > rgb_max_arr[c]) {
-                rgb_max_arr[c] = rgb888_arr[c];
-            }
-            if (rgb888_arr[c] < rgb_min_arr[c]) {
-                rgb_min_arr[c] = rgb888_arr[c];
-            }
-        }
-    }
-
-    for (int c = 0; c < 3; c++) {
-        rgb_ranges[c] = rgb_max_arr[c] - rgb_min_arr[c];
-    }
-
-    if ((rgb_ranges[0] >= rgb_ranges[1]) && (rgb_ranges[0] >= rgb_ranges[1])) {
+// Determine which color channel has the largest max/min difference, preferring red, then green, on ties
+int get_longest_dim(const uint8_t *rgb_ranges) {
+    if ((rgb_ranges[0] >= rgb_ranges[1]) && (rgb_ranges[0] >= rgb_ranges[2])) {
         return 0;
     }
     if ((rgb_ranges[1] >= rgb_ranges[0]) && (rgb_ranges[1] >= rgb_ranges[2])) {
@@ -53,66 +58,6 @@ int get_longest_dim(uint16_t *rgb565_arr, uint32_t length) {
     return -1;  // should never get here
 }
 
-// Sorting function for red color channel
-bool red_is_larger(uint16_t first, uint16_t second) {
-    uint8_t rgb888_first_arr[3];
-    uint8_t rgb888_second_arr[3];
-
-    // Convert to rgb888
-    rgb565_to_rgb888(first, rgb888_first_arr);
-    rgb565_to_rgb888(second, rgb888_second_arr);
-
-    if (rgb888_first_arr[0] > rgb888_second_arr[0]) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-// Sorting function for green color channel
-bool green_is_larger(uint16_t first, uint16_t second) {
-    uint8_t rgb888_first_arr[3];
-    uint8_t rgb888_second_arr[3];
-
-    // Convert to rgb888
-    rgb565_to_rgb888(first, rgb888_first_arr);
-    rgb565_to_rgb888(second, rgb888_second_arr);
-
-    if (rgb888_first_arr[1] > rgb888_second_arr[1]) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-// Sorting function for blue color channel
-bool blue_is_larger(uint16_t first, uint16_t second) {
-    uint8_t rgb888_first_arr[3];
-    uint8_t rgb888_second_arr[3];
-
-    // Convert to rgb888
-    rgb565_to_rgb888(first, rgb888_first_arr);
-    rgb565_to_rgb888(second, rgb888_second_arr);
-
-    if (rgb888_first_arr[2] > rgb888_second_arr[2]) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-// Sorting function for hue
-bool hue_is_larger(rgb888_t first, rgb888_t second) {
-    uint8_t first_hue = rgb888_to_hue(first);
-    uint8_t second_hue = rgb888_to_hue(second);
-
-    if (first_hue > second_hue) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
 // Calculates hue
 uint8_t rgb888_to_hue(rgb888_t rgb888) {
     // normalize
@@ -148,54 +93,25 @@ uint8_t rgb888_to_luma(uint8_t *rgb888_arr) {
     return 0.2126 * rgb888_arr[0] + 0.7152 * rgb888_arr[1] + 0.0722 * rgb888_arr[2];
 }
 
-// Reverse sorting function for luma
-bool luma_is_smaller(uint16_t first, uint16_t second) {
-    uint8_t rgb888_first_arr[3];
-    uint8_t rgb888_second_arr[3];
-
-    // Convert to rgb888
-    rgb565_to_rgb888(first, rgb888_first_arr);
-    rgb565_to_rgb888(second, rgb888_second_arr);
-
-    uint8_t luma_first = rgb888_to_luma(rgb888_first_arr);
-    uint8_t luma_second = rgb888_to_luma(rgb888_second_arr);
-
-    if (luma_first < luma_second) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
+// Moves the pixels at or above the luma threshold to the front of the array and returns how many there are
 uint32_t length_above_luma_thresh(uint16_t *rgb565_arr, uint32_t length, uint8_t threshold) {
-    sortArray(rgb565_arr, length, luma_is_smaller);  // sort by descending luma
-    uint32_t idx;
+    init_rgb565_decode();
+
+    uint32_t idx = 0;
     uint8_t rgb888_arr[3];
-    uint8_t luma;
 
-    for (idx = 0; idx < length; idx++) {
-        rgb565_to_rgb888(rgb565_arr[idx], rgb888_arr);
-        luma = rgb888_to_luma(rgb888_arr);
-        if (luma < threshold) break;
+    for (uint32_t i = 0; i < length; i++) {
+        for (int c = 0; c < 3; c++) {
+            rgb888_arr[c] = rgb565_decode[c][rgb565_channel(rgb565_arr[i], c)];
+        }
+        if (rgb888_to_luma(rgb888_arr) >= threshold) {
+            rgb565_arr[idx++] = rgb565_arr[i];
+        }
     }
 
     return idx;
 }
 
-void sort_by_channel(uint16_t *rgb565_arr, uint32_t length, uint8_t channel) {
-    switch (channel) {
-        case 0:
-            sortArray(rgb565_arr, length, red_is_larger);
-            break;
-        case 1:
-            sortArray(rgb565_arr, length, green_is_larger);
-            break;
-        case 2:
-            sortArray(rgb565_arr, length, blue_is_larger);
-            break;
-    }
-}
-
 // Calculates the mean rgb888 value from an array of rgb565 values, and stores the result in a 3-element array passed in as an arg
 void get_mean_color(uint16_t *rgb565_arr, uint32_t length, uint8_t *mean_rgb888_arr) {
     if (length == 0) {  // avoid a divide by zero
@@ -203,15 +119,12 @@ void get_mean_color(uint16_t *rgb565_arr, uint32_t length, uint8_t *mean_rgb888_
     }
 
     uint32_t sum_rgb888_arr[3] = {0, 0, 0};
-    uint8_t curr_rgb888_arr[3];
 
     // loop through all pixels
-    for (int i = 0; i < length; i++) {
-        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
-
+    for (uint32_t i = 0; i < length; i++) {
         // loop through each channel
         for (int c = 0; c < 3; c++) {
-            sum_rgb888_arr[c] += curr_rgb888_arr[c];
+            sum_rgb888_arr[c] += rgb565_decode[c][rgb565_channel(rgb565_arr[i], c)];
         }
     }
 
@@ -221,78 +134,139 @@ void get_mean_color(uint16_t *rgb565_arr, uint32_t length, uint8_t *mean_rgb888_
     }
 }
 
-// Finds the closest index to the mean for the sorted longest_dim channel
-uint32_t get_mean_idx(uint16_t *rgb565_arr, uint32_t length, uint8_t channel) {
-    if (length == 0) {  // avoid a divide by zero
-        return 0;
+// Finds the channel value closest to the channel mean, returning it as an RGB565 channel value. Of two values
+// equally close, the lower one is returned.
+static uint8_t get_mean_value(const uint16_t *hist, uint32_t length, uint8_t channel) {
+    uint32_t sum = 0;
+    for (int i = 0; i < rgb565_bins[channel]; i++) {
+        sum += hist[i] * rgb565_decode[channel][i];
     }
+    float mean_val = float(sum) / length;
 
-    uint32_t sum = 0;
-    uint8_t curr_rgb888_arr[3];
-    float mean_val;
     float min_diff = 255;
-    uint32_t idx = 0;
-
-    // Find the channel mean
-    for (int i = 0; i < length; i++) {
-        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
-        sum += curr_rgb888_arr[channel];
-    }
-    mean_val = float(sum) / length;
-
-    // Find the closest idx to the mean for the channel we care about
-    for (int i = 0; i < length; i++) {
-        rgb565_to_rgb888(rgb565_arr[i], curr_rgb888_arr);
-        float curr_diff = abs(curr_rgb888_arr[channel] - mean_val);
-        if (curr_diff < min_diff) {
-            min_diff = curr_diff;
-            idx = i;
+    uint8_t mean_bin = 0;
+    for (int i = 0; i < rgb565_bins[channel]; i++) {
+        if (hist[i] > 0) {
+            float curr_diff = abs(rgb565_decode[channel][i] - mean_val);
+            if (curr_diff < min_diff) {
+                min_diff = curr_diff;
+                mean_bin = i;
+            }
         }
     }
 
-    return idx;
+    return mean_bin;
 }
 
-// Prepares the data before calling the recursive function that will actually compute the results
+// A range of the pixel array still to be split, and the first palette entry it will fill
+typedef struct mean_cut_range {
+    uint32_t offset;
+    uint32_t length;
+    uint8_t depth;
+    uint16_t result_idx;
+} mean_cut_range_t;
+
 void mean_cut(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
-    uint32_t new_length = length_above_luma_thresh(rgb565_arr, length, LUMA_THRESH);  // sort by luma and return how many values are above the threshold
+    if (depth > MEAN_CUT_MAX_DEPTH) {
+        print("Error: mean cut depth %d is too large, max is %d!\n", depth, MEAN_CUT_MAX_DEPTH);
+        depth = MEAN_CUT_MAX_DEPTH;
+    }
+
+    uint32_t new_length = length_above_luma_thresh(rgb565_arr, length, LUMA_THRESH);  // drop pixels below the threshold
+    mean_cut_buckets(rgb565_arr, new_length, depth, results);
+    sort_by_hue(results, 1 << depth);
+}
+
+// Splits the pixels into buckets, working through an explicit stack of ranges rather than recursing
+void mean_cut_buckets(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
+    if (depth > MEAN_CUT_MAX_DEPTH) {
+        print("Error: mean cut depth %d is too large, max is %d!\n", depth, MEAN_CUT_MAX_DEPTH);
+        depth = MEAN_CUT_MAX_DEPTH;
+    }
+    init_rgb565_decode();
 
-    mean_cut_recursive(rgb565_arr, new_length, depth, results);
+    // Each split pops one range and pushes two that are one level deeper, so the stack never holds more than
+    // depth + 1 ranges
+    mean_cut_range_t stack[MEAN_CUT_MAX_DEPTH + 1];
+    int stack_len = 0;
+    stack[stack_len++] = {0, length, depth, 0};
 
-    // cast to rgb888_t struct type to enable accessing rgb elements in sorting function
-    sortArray((rgb888_t *)results, 1 << depth, hue_is_larger);  // sort by increasing hue
+    while (stack_len > 0) {
+        mean_cut_range_t range = stack[--stack_len];
+        uint16_t *range_arr = rgb565_arr + range.offset;
+
+        if ((range.depth == 0) || (range.length == 0)) {  // if length is 0 we will get black
+            get_mean_color(range_arr, range.length, results + range.result_idx * 3);
+            continue;
+        }
+
+        uint32_t length0 = mean_cut_split(range_arr, range.length);
+
+        // The lower half fills the first half of this range's palette entries, so push it last to handle it first
+        // (1 << (depth - 1) is half the number of entries)
+        uint16_t half_entries = 1 << (range.depth - 1);
+        stack[stack_len++] = {range.offset + length0, range.length - length0, uint8_t(range.depth - 1), uint16_t(range.result_idx + half_entries)};
+        stack[stack_len++] = {range.offset, length0, uint8_t(range.depth - 1), range.result_idx};
+    }
 }
 
-// Recursive function that actually computes the results
-// Results will hold an array of 8-bit RGB triplets (e.g. {R1, G1, B1, R2, G2, B2, R3, G3, B3, ...})
-void mean_cut_recursive(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
-    if ((depth == 0) || (length == 0)) {  // if length is 0 we will get black
-        // uint8_t mean_rgb888_arr[3];
-        get_mean_color(rgb565_arr, length, results);
+// Sorts by increasing hue, keeping colors with the same hue in order. The hues are calculated once up front.
+void sort_by_hue(uint8_t *results, int num_colors) {
+    if (num_colors > (1 << MEAN_CUT_MAX_DEPTH)) {
+        print("Error: cannot sort %d colors by hue, max is %d!\n", num_colors, 1 << MEAN_CUT_MAX_DEPTH);
         return;
     }
 
-    uint8_t longest_dim = get_longest_dim(rgb565_arr, length);
-
-    sort_by_channel(rgb565_arr, length, longest_dim);
-    uint32_t split_idx = get_mean_idx(rgb565_arr, length, longest_dim);
+    rgb888_t *colors = (rgb888_t *)results;
+    uint8_t hues[1 << MEAN_CUT_MAX_DEPTH];
+    for (int i = 0; i < num_colors; i++) {
+        hues[i] = rgb888_to_hue(colors[i]);
+    }
+    for (int i = 1; i < num_colors; i++) {
+        rgb888_t color = colors[i];
+        uint8_t hue = hues[i];
+        int j = i;
+        for (; j > 0 && hues[j - 1] > hue; j--) {
+            colors[j] = colors[j - 1];
+            hues[j] = hues[j - 1];
+        }
+        colors[j] = color;
+        hues[j] = hue;
+    }
+}
 
-    // Determine lengths of each half of the array we are splitting into
-    uint32_t length0 = split_idx;           // int(length / 2);
-    uint32_t length1 = length - split_idx;  // length - length0;
+// Splits a bucket of pixels in place along the channel with the largest range, and returns the length of the lower half
+uint32_t mean_cut_split(uint16_t *rgb565_arr, uint32_t length) {
+    // Histogram of each channel
+    uint16_t hist[3][MEAN_CUT_BINS] = {{0}};
+    for (uint32_t i = 0; i < length; i++) {
+        for (int c = 0; c < 3; c++) {
+            hist[c][rgb565_channel(rgb565_arr[i], c)]++;
+        }
+    }
 
-    // Copy the contents of our original array into the new split arrays
-    uint16_t rgb565_arr_0[length0];
-    memcpy(rgb565_arr_0, rgb565_arr, sizeof(rgb565_arr_0));
+    // Range of each channel, from the lowest and highest non-empty bins
+    uint8_t rgb_ranges[3];
+    for (int c = 0; c < 3; c++) {
+        int lo = 0;
+        int hi = rgb565_bins[c] - 1;
+        while (hist[c][lo] == 0) lo++;
+        while (hist[c][hi] == 0) hi--;
+        rgb_ranges[c] = rgb565_decode[c][hi] - rgb565_decode[c][lo];
+    }
 
-    uint16_t rgb565_arr_1[length1];
-    memcpy(rgb565_arr_1, rgb565_arr + length0, sizeof(rgb565_arr_1));
+    uint8_t longest_dim = get_longest_dim(rgb_ranges);
+    uint8_t mean_bin = get_mean_value(hist[longest_dim], length, longest_dim);
 
-    // Spawn two recursive calls to handle each "half" of the pixels
-    mean_cut(rgb565_arr_0, length0, depth - 1, results);
+    // Split the pixels below the mean value from the rest
+    uint32_t length0 = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        if (rgb565_channel(rgb565_arr[i], longest_dim) < mean_bin) {
+            uint16_t tmp = rgb565_arr[length0];
+            rgb565_arr[length0++] = rgb565_arr[i];
+            rgb565_arr[i] = tmp;
+        }
+    }
 
-    // Pointer arithmetic to pass the appropriate array for the second half
-    // (1 << (depth - 1) is half the total number of entries, 3 is the number of channels
-    uint8_t *results1_ptr = results + ((1 << (depth - 1)) * 3 * sizeof(results[0]));
-    mean_cut(rgb565_arr_1, length1, depth - 1, results1_ptr);
+    return length0;
 }
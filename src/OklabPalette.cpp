@@ -0,0 +1,149 @@
+#include "OklabPalette.h"
+
+#include "Utils.h"
+
+typedef struct oklab {
+    float L;
+    float a;
+    float b;
+} oklab_t;
+
+// Linear light value of each RGB565 channel value, indexed like the channel bits
+static float rgb565_linear[3][64];
+
+// Fills the rgb565_linear lookup table
+static void init_rgb565_linear() {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+
+    for (int i = 0; i < 64; i++) {
+        uint8_t rgb888_arr[3];
+        rgb565_to_rgb888(((i & 0x1F) << 11) | (i << 5) | (i & 0x1F), rgb888_arr);
+        for (int c = 0; c < 3; c++) {
+            rgb565_linear[c][i] = pow(rgb888_arr[c] / 255.0, JPG_GAMMA);
+        }
+    }
+    initialized = true;
+}
+
+// Converts linear RGB to Oklab
+static oklab_t linear_to_oklab(float r, float g, float b) {
+    float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+
+    return {
+        0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+        1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+        0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s,
+    };
+}
+
+static oklab_t rgb565_to_oklab(uint16_t rgb565_val) {
+    return linear_to_oklab(rgb565_linear[0][(rgb565_val >> 11) & 0x1F],
+                           rgb565_linear[1][(rgb565_val >> 5) & 0x3F],
+                           rgb565_linear[2][rgb565_val & 0x1F]);
+}
+
+static oklab_t rgb888_to_oklab(const uint8_t *rgb888_arr) {
+    return linear_to_oklab(pow(rgb888_arr[0] / 255.0, JPG_GAMMA),
+                           pow(rgb888_arr[1] / 255.0, JPG_GAMMA),
+                           pow(rgb888_arr[2] / 255.0, JPG_GAMMA));
+}
+
+// Converts Oklab to gamma encoded RGB888, clipping colors outside of the RGB gamut
+static void oklab_to_rgb888(oklab_t lab, uint8_t *rgb888_arr) {
+    float l = lab.L + 0.3963377774f * lab.a + 0.2158037573f * lab.b;
+    float m = lab.L - 0.1055613458f * lab.a - 0.0638541728f * lab.b;
+    float s = lab.L - 0.0894841775f * lab.a - 1.2914855480f * lab.b;
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+
+    float linear[3] = {
+        +4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s,
+        -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s,
+        -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s,
+    };
+
+    for (int c = 0; c < 3; c++) {
+        float val = constrain(linear[c], 0.0f, 1.0f);
+        rgb888_arr[c] = round(pow(val, 1 / JPG_GAMMA) * 255);
+    }
+}
+
+static float oklab_dist_sq(const oklab_t &x, const oklab_t &y) {
+    float dL = x.L - y.L;
+    float da = x.a - y.a;
+    float db = x.b - y.b;
+    return dL * dL + da * da + db * db;
+}
+
+void oklab_palette(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results) {
+    init_rgb565_linear();
+
+    if ((1 << depth) > PALETTE_ENTRIES) {
+        print("Error: Oklab palette depth %d is too large, max is %d colors!\n", depth, PALETTE_ENTRIES);
+        depth = MEAN_CUT_DEPTH;
+    }
+
+    // Seed the palette with mean cut, on the same pixels it will consider
+    length = length_above_luma_thresh(rgb565_arr, length, LUMA_THRESH);
+    mean_cut_buckets(rgb565_arr, length, depth, results);
+
+    int num_colors = 1 << depth;
+    oklab_t centroids[PALETTE_ENTRIES];
+    for (int k = 0; k < num_colors; k++) {
+        centroids[k] = rgb888_to_oklab(results + k * 3);
+    }
+
+    for (int iter = 0; iter < PALETTE_KMEANS_ITERATIONS; iter++) {
+        oklab_t sums[PALETTE_ENTRIES] = {{0}};
+        uint32_t counts[PALETTE_ENTRIES] = {0};
+
+        // Assign each pixel to its nearest palette color
+        for (uint32_t i = 0; i < length; i++) {
+            oklab_t lab = rgb565_to_oklab(rgb565_arr[i]);
+
+            int nearest = 0;
+            float nearest_dist = oklab_dist_sq(lab, centroids[0]);
+            for (int k = 1; k < num_colors; k++) {
+                float dist = oklab_dist_sq(lab, centroids[k]);
+                if (dist < nearest_dist) {
+                    nearest_dist = dist;
+                    nearest = k;
+                }
+            }
+
+            sums[nearest].L += lab.L;
+            sums[nearest].a += lab.a;
+            sums[nearest].b += lab.b;
+            counts[nearest]++;
+        }
+
+        // Move each palette color to the mean of its pixels
+        bool changed = false;
+        for (int k = 0; k < num_colors; k++) {
+            if (counts[k] == 0) {
+                continue;
+            }
+            oklab_t mean = {sums[k].L / counts[k], sums[k].a / counts[k], sums[k].b / counts[k]};
+            if (oklab_dist_sq(mean, centroids[k]) > 0) {
+                changed = true;
+            }
+            centroids[k] = mean;
+        }
+
+        if (!changed) {
+            break;
+        }
+    }
+
+    for (int k = 0; k < num_colors; k++) {  // colors with no pixels convert back to their mean cut values
+        oklab_to_rgb888(centroids[k], results + k * 3);
+    }
+
+    sort_by_hue(results, num_colors);
+}
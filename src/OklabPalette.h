@@ -0,0 +1,34 @@
+#ifndef _OKLABPALETTE_H
+#define _OKLABPALETTE_H
+
+#include <Arduino.h>
+
+#include "Constants.h"
+#include "MeanCut.h"
+
+// This header and its associated OklabPalette.cpp file define a palette quantizer that works in the
+// Oklab color space (https://bottosson.github.io/posts/oklab/), where the distance between two colors
+// tracks how different they look far better than in RGB. Averaging in gamma-encoded RGB, as mean cut does,
+// pulls colors towards gray, which can make the palettes look muddy on the LEDs.
+//
+// The quantizer runs as follows:
+//      1. Run mean cut (see MeanCut.h) on the pixels to get the initial palette.
+//      2. Convert the palette to Oklab.
+//      3. Assign each pixel to the nearest palette color in Oklab.
+//      4. Replace each palette color with the Oklab mean of its pixels, leaving colors with no
+//          pixels unchanged.
+//      5. Repeat steps 3-4 up to PALETTE_KMEANS_ITERATIONS times (see Constants.h), or until the
+//          palette stops changing (i.e. k-means refinement).
+//      6. Convert the palette back to RGB888 and sort it by hue, as mean cut does.
+//
+// A table of Oklab values for every RGB565 color would take 768 KB, more than the ESP32 has. Instead each
+// RGB565 channel is linearized through a small lookup table, and the rest of the conversion (two 3x3
+// matrices and a cube root) is done per pixel as it is needed.
+//
+// Pixels are gamma decoded with JPG_GAMMA, matching how the rest of the program treats the artwork.
+
+// Computes the palette. Takes the same arguments as mean_cut(), and likewise reorders rgb565_arr.
+// At most PALETTE_ENTRIES colors are supported (see Constants.h).
+void oklab_palette(uint16_t *rgb565_arr, uint32_t length, uint8_t depth, uint8_t *results);
+
+#endif  // _OKLABPALETTE_H
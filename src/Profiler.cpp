@@ -0,0 +1,62 @@
+#include "Profiler.h"
+
+#include "Utils.h"
+
+Profiler::Profiler(const char *name, uint32_t report_interval_ms) {
+    _name = name;
+    _report_timer = Timer(report_interval_ms);
+}
+
+void Profiler::begin_frame() {
+    begin_frame(micros());
+}
+
+void Profiler::begin_frame(unsigned long start_us) {
+    _curr_stage = 0;
+    _last_mark_us = start_us;
+}
+
+void Profiler::mark(const char *stage_name) {
+    unsigned long now_us = micros();
+
+    if (_curr_stage < MAX_PROFILER_STAGES) {
+        _stage_names[_curr_stage] = stage_name;
+        _stage_us[_curr_stage] += now_us - _last_mark_us;
+        _curr_stage++;
+        if (_curr_stage > _num_stages) {
+            _num_stages = _curr_stage;
+        }
+    }
+    _last_mark_us = now_us;
+}
+
+void Profiler::end_frame() {
+    _frames++;
+
+    if (_report_timer.has_elapsed(false)) {
+        _report(_report_timer.get_time_elapsed_ms());
+        _report_timer.reset();
+    }
+}
+
+void Profiler::count(uint32_t n) {
+    _counter += n;
+}
+
+void Profiler::_report(uint32_t elapsed_ms) {
+    if (_frames == 0) {
+        return;
+    }
+
+    uint32_t total_us = 0;
+    print("[%s] ", _name);
+    for (int i = 0; i < _num_stages; i++) {
+        print("%s: %d us, ", _stage_names[i], _stage_us[i] / _frames);
+        total_us += _stage_us[i];
+    }
+    print("total: %d us/frame, %.1f frames/sec, count: %d\n", total_us / _frames, _frames * 1000.0 / elapsed_ms, _counter);
+
+    memset(_stage_us, 0, sizeof(_stage_us));
+    _frames = 0;
+    _counter = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <Arduino.h>
+
+#include "Timer.h"
+
+#define MAX_PROFILER_STAGES 8
+
+// The Profiler class is a lightweight instrumentation helper for timing the stages of a loop that
+// runs once per frame (e.g. the audio pipeline). Call begin_frame() at the top of the loop and
+// mark() at the end of each stage; stages are identified by the order in which they are marked.
+// Calling end_frame() accumulates the frame and, once every report interval, prints the average
+// time per stage (in microseconds per frame) and the frame rate over serial.
+class Profiler {
+   public:
+    // Constructor, accepts a name to print with each report and the report interval in milliseconds.
+    Profiler(const char *name, uint32_t report_interval_ms = 1000);
+
+    // Starts timing a new frame.
+    void begin_frame();
+
+    // Starts timing a new frame that began at start_us (as returned by micros()), e.g. when the frame's data was
+    // captured by another task. The first stage then includes the time before this call.
+    void begin_frame(unsigned long start_us);
+
+    // Marks the end of a stage. The stage name should be a string literal.
+    void mark(const char *stage_name);
+
+    // Ends the frame, printing a report if the report interval has elapsed.
+    void end_frame();
+
+    // Adds a count to a user-defined counter (e.g. dropped frames) that is printed with each report.
+    void count(uint32_t n = 1);
+
+   private:
+    // Prints the accumulated stats over serial and resets them.
+    void _report(uint32_t elapsed_ms);
+
+    const char *_name;
+    const char *_stage_names[MAX_PROFILER_STAGES] = {NULL};
+    uint32_t _stage_us[MAX_PROFILER_STAGES] = {0};  // accumulated time per stage since last report
+    int _num_stages = 0;
+    int _curr_stage = 0;
+
+    unsigned long _last_mark_us = 0;
+    uint32_t _frames = 0;   // frames since last report
+    uint32_t _counter = 0;  // user-defined counter since last report
+
+    Timer _report_timer;
+};
+
+#endif  // _PROFILER_H
@@ -0,0 +1,105 @@
+#include "Resampler.h"
+
+// Constructor, calculates the resampling plan
+Resampler::Resampler(int old_length, int new_length) {
+    _old_length = old_length;
+    _new_length = new_length;
+    _start = new uint16_t[new_length];
+    _len = new uint16_t[new_length];
+
+    // Each output averages multiple interpolated points, where multiple is 1 unless we are downsampling
+    int multiple = (new_length < old_length) ? int(ceil(double(old_length) / new_length)) : 1;
+    int num_points = multiple * new_length;
+
+    // First pass finds the range of inputs used by each output, so we know how many weights to allocate
+    int num_weights = 0;
+    int max_len = 0;
+    for (int i = 0; i < new_length; i++) {
+        int first, last;
+        double frac;
+        _point_position(i * multiple, num_points, &first, &frac);
+        _point_position((i + 1) * multiple - 1, num_points, &last, &frac);
+        if (frac > 0 && last + 1 < old_length) {
+            last++;  // the last point uses the next input too
+        }
+
+        _start[i] = first;
+        _len[i] = last - first + 1;
+        num_weights += _len[i];
+        max_len = max(max_len, int(_len[i]));
+    }
+
+    // Second pass accumulates the weights of each interpolated point and converts them to Q8
+    _weights = new uint16_t[num_weights];
+    double *acc = new double[max_len];
+    uint16_t *w = _weights;
+    for (int i = 0; i < new_length; i++) {
+        memset(acc, 0, _len[i] * sizeof(acc[0]));
+
+        for (int j = 0; j < multiple; j++) {
+            int index;
+            double frac;
+            _point_position(i * multiple + j, num_points, &index, &frac);
+
+            acc[index - _start[i]] += (1 - frac) / multiple;
+            if (index + 1 < old_length) {
+                if (frac > 0) {
+                    acc[index + 1 - _start[i]] += frac / multiple;
+                }
+            } else {
+                acc[index - _start[i]] += frac / multiple;  // past the end, so hold the last value
+            }
+        }
+
+        // Round to Q8, then give any rounding error to the largest weight so the weights always sum to 1.0
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < _len[i]; k++) {
+            w[k] = uint16_t(round(acc[k] * (1 << RESAMPLER_Q_BITS)));
+            sum += w[k];
+            if (w[k] > w[largest]) {
+                largest = k;
+            }
+        }
+        w[largest] += (1 << RESAMPLER_Q_BITS) - sum;
+
+        w += _len[i];
+    }
+    delete[] acc;
+}
+
+Resampler::~Resampler() {
+    delete[] _start;
+    delete[] _len;
+    delete[] _weights;
+}
+
+void Resampler::apply(const float *in, float *out) {
+    const float scale = 1.0 / (1 << RESAMPLER_Q_BITS);
+    const uint16_t *w = _weights;
+
+    for (int i = 0; i < _new_length; i++) {
+        const float *x = &in[_start[i]];
+        float sum = 0;
+        for (int k = 0; k < _len[i]; k++) {
+            sum += x[k] * w[k];
+        }
+        out[i] = sum * scale;
+        w += _len[i];
+    }
+}
+
+int Resampler::get_old_length() {
+    return _old_length;
+}
+
+int Resampler::get_new_length() {
+    return _new_length;
+}
+
+// Interpolated points are evenly spaced so that the first and last points line up with the first and last inputs
+void Resampler::_point_position(int point, int num_points, int *index, double *frac) {
+    double pos = (num_points > 1) ? point / double(num_points - 1) * (_old_length - 1) : 0;
+    *index = min(int(floor(pos)), _old_length - 1);
+    *frac = pos - *index;
+}
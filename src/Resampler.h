@@ -0,0 +1,42 @@
+#ifndef _RESAMPLER_H
+#define _RESAMPLER_H
+
+#include <Arduino.h>
+
+#define RESAMPLER_Q_BITS 8  // resampling weights are stored as Q8, i.e. 1.0 = 1 << RESAMPLER_Q_BITS
+
+// The Resampler class resizes an array to a new length using a resampling plan calculated once in the
+// constructor. Each output is a weighted sum of a contiguous run of inputs, so up- and downsampling are
+// both a single multiply-add pass with no temporary buffers.
+//
+// Upsampling linearly interpolates between the two nearest inputs. Downsampling first linearly interpolates
+// up to the smallest integer multiple of the new length that is at least the old length, then averages each
+// group of that many points down to one output; the plan folds both steps into a single set of weights.
+class Resampler {
+   public:
+    // Constructor, accepts the input and output lengths.
+    Resampler(int old_length, int new_length);
+    ~Resampler();
+
+    // Resamples old_length values from in to new_length values in out.
+    void apply(const float *in, float *out);
+
+    // Returns the input length.
+    int get_old_length();
+
+    // Returns the output length.
+    int get_new_length();
+
+   private:
+    // Calculates the position in the input of the given interpolated point, splitting it into the index of
+    // the input before it and the fractional distance to the next input.
+    void _point_position(int point, int num_points, int *index, double *frac);
+
+    int _old_length;
+    int _new_length;
+    uint16_t *_start;     // first input used by each output
+    uint16_t *_len;       // number of inputs used by each output
+    uint16_t *_weights;   // Q8 weights for all outputs, packed back to back, summing to 1.0 for each output
+};
+
+#endif  // _RESAMPLER_H
@@ -10,15 +10,21 @@
 #include <TJpg_Decoder.h>
 #include <WiFi.h>
 
+#include "ArtSampler.h"
 #include "AudioProcessor.h"
 #include "ButtonFSM.h"
 #include "CLI.h"
+#include "Compositor.h"
 #include "Constants.h"
 #include "EventHandler.h"
+#include "FrameQueue.h"
+#include "GammaTable.h"
 #include "LEDPanel.h"
 #include "MeanCut.h"
 #include "Mode.h"
 #include "ModeSequence.h"
+#include "OklabPalette.h"
+#include "Profiler.h"
 #include "Spotify.h"
 #include "Utils.h"
 #include "WebServer.h"
@@ -29,15 +35,23 @@
 bool copy_jpg_data(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap);  // callback function for JPG decoder
 bool display_jpg_data(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap);
 
-void display_full_art(uint8_t offset_row, uint8_t offset_col);
-void decode_art(uint8_t *art_data, unsigned long art_num_bytes);
+void display_full_art(uint8_t offset_row, uint8_t offset_col);  // offsets only apply with ART_FULL_RES
+void decode_art(uint8_t *art_data, unsigned long art_num_bytes, const char *art_url);
 
 void display_image(const char *filepath);
 bool download_image(const char *url, const char *filepath);
 
-void run_audio(AudioProcessor *ap, int audio_mode);
+void start_transition(uint32_t duration_ms, Compositor::curve_t curve);
+
+unsigned long run_audio(AudioProcessor *ap, int audio_mode);
 void test_modes();
 
+#ifdef PROFILE_AUDIO
+#define PROFILE_AUDIO_MARK(stage) profiler.mark(stage)
+#else
+#define PROFILE_AUDIO_MARK(stage)
+#endif
+
 /*** Globals ***/
 
 // EventHandler
@@ -65,7 +79,12 @@ QueueHandle_t q_spotify;
 TaskHandle_t task_audio;
 QueueHandle_t q_audio;
 
+TaskHandle_t task_render;
+QueueHandle_t q_render;
+
 TaskHandle_t task_display;
+
+TaskHandle_t task_leds;
 QueueHandle_t q_display;
 
 TaskHandle_t task_servo;
@@ -79,18 +98,62 @@ void task_eventhandler_code(void *parameter);
 void task_buttons_code(void *parameter);
 void task_spotify_code(void *parameter);
 void task_audio_code(void *parameter);
+void task_render_code(void *parameter);
 void task_display_code(void *parameter);
+void task_leds_code(void *parameter);
 void task_servo_code(void *parameter);
 void task_mode_code(void *parameter);
 
 typedef struct AlbumArt {
-    uint16_t full_art_rgb565[64][64] = {{0}};     // full resolution RGB565 artwork
-    uint16_t palette_art_rgb565[16][16] = {{0}};  // artwork to use for palette creation
+#ifdef ART_FULL_RES
+    CRGB full_art_crgb[64][64] = {{0}};           // full resolution artwork, gamma corrected for the LEDs
+#endif
+    CRGB art_crgb[GRID_H][GRID_W] = {{0}};        // artwork averaged down to one pixel per LED, gamma corrected for the LEDs
+    uint16_t palette_art_rgb565[PALETTE_ART_SIZE][PALETTE_ART_SIZE] = {{0}};  // artwork to use for palette creation, reordered by mean_cut()
     CRGB palette_crgb[PALETTE_ENTRIES] = {0};     // color palette from album art
 } AlbumArt_t;
 AlbumArt_t album_art;
+ArtSampler art_sampler = ArtSampler((uint16_t *)album_art.palette_art_rgb565);  // downsamples the art as it is decoded
+#ifdef ART_FULL_RES
+uint16_t full_art_src_w = 0;  // size of the art as decoded, which copy_jpg_data() maps onto full_art_crgb
+uint16_t full_art_src_h = 0;
+#endif
 
-LEDPanel lp = LEDPanel(GRID_W, GRID_H, NUM_LEDS, PIN_LED_CONTROL, MAX_BRIGHT, true, LEDPanel::BOTTOM_LEFT);
+// Palettes of recently played album art, so that going back to an album does not recalculate its palette
+typedef struct PaletteCacheEntry {
+    char art_url[CLI_MAX_CHARS] = "";
+    CRGB palette_crgb[PALETTE_ENTRIES] = {0};
+} PaletteCacheEntry_t;
+PaletteCacheEntry_t palette_cache[PALETTE_CACHE_ENTRIES];
+int palette_cache_next = 0;  // entry to replace next, the oldest one
+
+// Audio frames are passed from the audio (capture/FFT) task to the render task through a lock-free queue
+typedef struct AudioFrame {
+    uint32_t seq;              // sequence number, increments by one for every frame captured
+    unsigned long capture_us;  // time at which the newest audio sample in the frame was captured
+    int audio_mode;            // audio submode used to calculate the intensities
+    double tempo;              // tempo in beats per minute, 0 if unknown
+    double beat_phase;         // position within the current beat, from 0 (on the beat) up to 1
+    int intensity[NUM_LEDS];   // LED intensities from the AudioProcessor
+} AudioFrame_t;
+FrameQueue<AudioFrame_t, AUDIO_FRAME_QUEUE_LEN> audio_frames;
+
+// Physical LED panels making up the canvas, one per data pin. Add a panel here for each tile when increasing
+// PANEL_TILES_X/PANEL_TILES_Y.
+const LEDPanel::tile_t led_tiles[] = {
+    // pin, x, y, width, height, serpentine, first pixel, column major
+    {PIN_LED_CONTROL, 0, 0, PANEL_TILE_W, PANEL_TILE_H, true, LEDPanel::BOTTOM_LEFT, false},
+};
+LEDPanel lp = LEDPanel(GRID_W, GRID_H, led_tiles, ARRAY_SIZE(led_tiles), MAX_BRIGHT);
+
+// Layers composited on top of the LEDs drawn by the current mode, from the bottom up. Guarded by mutex_leds.
+Compositor comp = Compositor(&lp);
+CRGB transition_leds[NUM_LEDS];                // LEDs to cross-fade from after the mode or art changes
+CRGB progress_leds[GRID_W];                    // elapsed track time bar along the bottom of the array
+uint8_t progress_alpha[GRID_W];
+int layer_transition;
+int layer_progress;
+int layer_palette;
 
 // ISRs
 void IRAM_ATTR deep_sleep_start_isr() {
@@ -177,6 +240,10 @@ void setup() {
     // LED Setup
     print("Setting up LEDs\n");
     lp.init();
+    layer_transition = comp.add_layer("transition", transition_leds, NUM_LEDS);
+    layer_progress = comp.add_layer("progress", progress_leds, GRID_W, progress_alpha);
+    layer_palette = comp.add_layer("palette", album_art.palette_crgb, PALETTE_ENTRIES);
+    fill_solid(progress_leds, GRID_W, CRGB::Red);
 
     print("Setup complete\n\n");
 
@@ -203,7 +270,7 @@ void setup() {
     eh.register_task(&task_spotify, q_spotify, EVENT_START | EVENT_MODE_CHANGED);
 
     q_display = xQueueCreate(10, sizeof(event_t));
-    eh.register_task(&task_display, q_display, EVENT_START | EVENT_MODE_CHANGED | EVENT_SPOTIFY_UPDATED | EVENT_AUDIO_FRAME_DONE);
+    eh.register_task(&task_display, q_display, EVENT_START | EVENT_MODE_CHANGED | EVENT_SPOTIFY_UPDATED);
 
     q_buttons = xQueueCreate(10, sizeof(event_t));
     eh.register_task(&task_buttons, q_buttons, EVENT_START);
@@ -211,12 +278,26 @@ void setup() {
     q_audio = xQueueCreate(10, sizeof(event_t));
     eh.register_task(&task_audio, q_audio, EVENT_START | EVENT_MODE_CHANGED);
 
+    q_render = xQueueCreate(10, sizeof(event_t));
+    eh.register_task(&task_render, q_render, EVENT_START | EVENT_MODE_CHANGED);
+
     q_servo = xQueueCreate(10, sizeof(event_t));
     eh.register_task(&task_servo, q_servo, EVENT_START | EVENT_SERVO_POS_CHANGED | EVENT_MODE_CHANGED);
 
     q_mode = xQueueCreate(10, sizeof(event_t));
     eh.register_task(&task_mode, q_mode, EVENT_START | EVENT_BUTTON_PRESSED | EVENT_SPOTIFY_UPDATED | EVENT_POWER_OFF | EVENT_REBOOT);
 
+    // Setup LED output task first, as the other tasks notify it whenever they show the LEDs
+    xTaskCreatePinnedToCore(
+        task_leds_code,  // Function to implement the task
+        "task_leds",     // Name of the task
+        2500,            // Stack size in bytes
+        NULL,            // Task input parameter
+        2,               // Priority of the task (don't use 0!), above the tasks that draw so frames go out promptly
+        &task_leds,      // Task handle
+        1                // Pinned core, 1 is preferred to avoid glitches (see task_display)
+    );
+
     xTaskCreatePinnedToCore(
         task_spotify_code,  // Function to implement the task
         "task_spotify",     // Name of the task
@@ -262,9 +343,19 @@ void setup() {
         "task_audio",     // Name of the task
         25000,            // Stack size in bytes
         q_audio,          // Task input parameter
-        1,                // Priority of the task (don't use 0!)
+        2,                // Priority of the task (don't use 0!), above the Spotify task so https requests don't stall the FFT
         &task_audio,      // Task handle
-        1                 // Pinned core
+        0                 // Pinned core, 0 to keep the FFT off the core that renders and shows the LEDs
+    );
+
+    xTaskCreatePinnedToCore(
+        task_render_code,  // Function to implement the task
+        "task_render",     // Name of the task
+        4000,              // Stack size in bytes
+        q_render,          // Task input parameter
+        1,                 // Priority of the task (don't use 0!)
+        &task_render,      // Task handle
+        1                  // Pinned core, same as the display task
     );
 
     xTaskCreatePinnedToCore(
@@ -377,10 +468,60 @@ void test_modes() {
     main_modes.submode().description();
 }
 
-void show_leds() {
+// Publishes the LEDs for the LED output task to show, without waiting for them to update. Returns false (and
+// skips the update) if the LEDs have not changed since they were last shown.
+bool show_leds() {
     xSemaphoreTake(mutex_leds, portMAX_DELAY);
-    FastLED.show();
+    bool changed = lp.publish();
     xSemaphoreGive(mutex_leds);
+
+    if (changed) {
+        xTaskNotifyGive(task_leds);
+    }
+    return changed;
+}
+
+// Starts a cross-fade from the LEDs as last drawn to whatever is drawn next, hiding the overlays of the last mode.
+// Call with mutex_leds held, before drawing the first frame of the new mode.
+void start_transition(uint32_t duration_ms, Compositor::curve_t curve) {
+    lp.copy_leds(transition_leds, NUM_LEDS);
+    comp.set_opacity(layer_transition, 255);
+    comp.fade(layer_transition, 0, duration_ms, curve);
+
+    comp.set_opacity(layer_progress, 0);
+    comp.set_opacity(layer_palette, 0);
+}
+
+// Shows frames as they are published, so the tasks that draw them can get on with the next frame while the
+// LEDs update. While the frame is dithering, it is also re-sent at FPS when no new frames arrive, for up to
+// LED_DITHER_RESENDS times (see LEDPanel::show()).
+void task_leds_code(void *parameter) {
+    print("task_leds_code running on core ");
+    print("%d\n", xPortGetCoreID());
+
+#ifdef PROFILE_AUDIO
+    static Profiler profiler("leds");  // total is the latency from publish to LEDs shown, count is frames replaced before being shown
+    uint32_t last_replaced = 0;
+#endif
+
+    for (;;) {
+        TickType_t wait = lp.is_dithering() ? pdMS_TO_TICKS(1000 / FPS) : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, wait);  // wait for a frame to be published
+
+        if (lp.show()) {
+#ifdef PROFILE_AUDIO
+            LEDPanel::output_stats_t stats = lp.get_output_stats();
+            uint32_t replaced = stats.frames_published - stats.frames_shown;
+            profiler.begin_frame(stats.publish_us);
+            profiler.mark("show");
+            profiler.count(replaced - last_replaced);
+            profiler.end_frame();
+            last_replaced = replaced;
+#endif
+        }
+    }
+
+    vTaskDelete(NULL);
 }
 
 void task_display_code(void *parameter) {
@@ -389,6 +530,8 @@ void task_display_code(void *parameter) {
 
     TickType_t xLastWakeTime;
     const TickType_t xFrequency = (1000.0 / FPS) / portTICK_RATE_MS;
+    const TickType_t max_idle_wait = DISPLAY_IDLE_MAX_MS / portTICK_RATE_MS;
+    TickType_t idle_wait = 0;  // while the LEDs are not changing, wait this long for an event before redrawing
 
     Spotify::public_data_t sp_data;
     BaseType_t q_return;
@@ -396,6 +539,8 @@ void task_display_code(void *parameter) {
     // int counter = 0;
 
     curr_mode_t curr_mode;
+    int last_main_mode = -1;
+    bool art_changed = false;
 
     // Initialise the xLastWakeTime variable with the current time.
     xLastWakeTime = xTaskGetTickCount();
@@ -417,8 +562,14 @@ void task_display_code(void *parameter) {
     }
 
     for (;;) {
-        // Check for received events
-        q_return = xQueueReceive(q, &received_event, 0);
+        // Check for received events. If the LEDs have stopped changing, back off by waiting for an event, which
+        // wakes us straight away, rather than redrawing the same frame every cycle.
+        q_return = xQueueReceive(q, &received_event, idle_wait);
+        if (idle_wait > 0) {
+            xLastWakeTime = xTaskGetTickCount();  // don't try to catch up on the cycles we waited through
+        }
+        bool changed = true;
+
         if (q_return == pdTRUE) {
             switch (received_event.event_type) {
                 case EVENT_MODE_CHANGED:
@@ -427,52 +578,51 @@ void task_display_code(void *parameter) {
                 case EVENT_SPOTIFY_UPDATED:
                     sp_data = received_event.sp_data;
                     percent_complete = sp_data.track_progress * 100;
-                    break;
-                case EVENT_AUDIO_FRAME_DONE:
-                    if (curr_mode.main.id() == MODE_MAIN_AUDIO) {
-                        // int new_pos = SERVO_NOISE_POS;  // this moves to the audio function
-                        // xQueueSend(q_servo, &new_pos, 0);
-                        show_leds();
-                    }
+                    art_changed |= sp_data.art_changed;
                     break;
                 default:
                     print("WARNING: task_display_code received unexpected event type %d!\n", received_event.event_type);
             }
         }
 
+        bool entered_mode = (curr_mode.main.id() != last_main_mode);
+        last_main_mode = curr_mode.main.id();
+
         switch (curr_mode.main.id()) {
             case MODE_MAIN_ART: {
                 // Display art and current elapsed regardless of if we have new data from the queue
                 if (sp_data.art_loaded && sp_data.is_active) {
                     xSemaphoreTake(mutex_leds, portMAX_DELAY);
 
+                    if (entered_mode || art_changed) {  // fade in the new art
+                        start_transition(ART_FADE_MS, Compositor::CURVE_EASE_IN_OUT);
+                        art_changed = false;
+                    }
                     display_full_art(0, 0);
-                    switch (curr_mode.sub.id()) {
-                        case MODE_ART_WITH_ELAPSED: {  // Update the LED indicator at the bottom of the array
-                            int grid_pos = int(round(percent_complete / 100 * GRID_W));
-
-                            for (int i = 0; i < GRID_W; i++) {
-                                if (i < grid_pos) {
-                                    lp.set(i, CRGB::Red);
-                                }
-                            }
-                            break;
-                        }
-                        case MODE_ART_WITH_PALETTE:  // Update the bottom of the array with the palette
-                            for (int i = 0; i < PALETTE_ENTRIES; i++) {
-                                lp.set(i, album_art.palette_crgb[i]);
-                            }
-                            break;
+
+                    // Overlay the elapsed time or the palette at the bottom of the array
+                    int grid_pos = int(round(percent_complete / 100 * GRID_W));
+                    for (int i = 0; i < GRID_W; i++) {
+                        progress_alpha[i] = (i < grid_pos) ? 255 : 0;
                     }
+                    comp.set_opacity(layer_progress, (curr_mode.sub.id() == MODE_ART_WITH_ELAPSED) ? 255 : 0);
+                    comp.set_opacity(layer_palette, (curr_mode.sub.id() == MODE_ART_WITH_PALETTE) ? 255 : 0);
+                    comp.composite();
+
                     xSemaphoreGive(mutex_leds);
-                    show_leds();
+                    changed = show_leds();
                 } else {  // no art, go blank
                     // // move before we display
                     // event_t e = {.event_type = EVENT_SERVO_POS_CHANGED, {.servo_pos = SERVO_POS_NOISE}};
                     // eh.emit(e);
 
-                    FastLED.clear();
-                    show_leds();
+                    xSemaphoreTake(mutex_leds, portMAX_DELAY);
+                    lp.clear();
+                    comp.set_opacity(layer_progress, 0);
+                    comp.set_opacity(layer_palette, 0);
+                    comp.composite();
+                    xSemaphoreGive(mutex_leds);
+                    changed = show_leds();
                 }
                 break;
             }
@@ -496,6 +646,14 @@ void task_display_code(void *parameter) {
         }
         lp.blend_palettes(PALETTE_CHANGE_RATE);
 
+        // Double the wait each cycle the LEDs don't change, and go back to every cycle as soon as they do (or while
+        // the palette is still blending or a transition is running)
+        if (changed || q_return == pdTRUE || lp.get_palette() != lp.get_target_palette() || comp.is_fading()) {
+            idle_wait = 0;
+        } else {
+            idle_wait = min(max(idle_wait * 2, xFrequency), max_idle_wait);
+        }
+
         // vTaskDelay((1000 / FPS) / portTICK_RATE_MS);
         //   Serial.println(FastLED.getFPS());
         taskYIELD();  // yield first in case the next line doesn't actually delay
@@ -503,25 +661,25 @@ void task_display_code(void *parameter) {
     }
 }
 
+// Captures audio and runs the FFT, passing the resulting LED intensities to the render task
 void task_audio_code(void *parameter) {
     print("task_audio_code running on core ");
     print("%d\n", xPortGetCoreID());
 
-    // TickType_t xLastWakeTime;
-    // const TickType_t xFrequency = ((FFT_SAMPLES / 2.0) / I2S_SAMPLE_RATE * 1000) / portTICK_RATE_MS;
-
+#ifdef AUDIO_SOURCE_TONE
+    ToneAudioSource tone = ToneAudioSource(AUDIO_TONE_FREQ, 0.5, 0.01);
+    AudioProcessor ap = AudioProcessor(false, false, true, true, &tone);
+#else
     AudioProcessor ap = AudioProcessor(false, false, true, true);
+#endif
 
-    CRGB last_leds[NUM_LEDS] = {0};  // capture the last led state before transitioning to a new mode;
+    static AudioFrame_t frame;  // static to keep it off the task stack
+    uint32_t seq = 0;
     BaseType_t q_return;
-    int servo_pos_delta = abs(SERVO_POS_ART - SERVO_POS_NOISE);
-    int blend_counter = 0;
-    int max_blend_count = int((SERVO_CYCLE_TIME_MS / 1000.0 * servo_pos_delta) * FPS * 1.25);
 
     QueueHandle_t q = (QueueHandle_t)parameter;  // q for receiving events
     event_t received_event = {};
-    event_t e = {};
-    curr_mode_t curr_mode, last_mode;
+    curr_mode_t curr_mode;
 
     q_return = xQueueReceive(q, &received_event, portMAX_DELAY);  // wait for start signal
     if (q_return == pdTRUE && received_event.event_type == EVENT_START) {
@@ -535,10 +693,6 @@ void task_audio_code(void *parameter) {
         print("WARNING: Did not get a valid initial mode!\n");
     }
 
-    // Initialise the xLastWakeTime variable with the current time.
-    // xLastWakeTime = xTaskGetTickCount();
-
-    int last_audio_mode = -1;
     for (;;) {
         if (ap.is_active()) {                                 // don't run the loop if AP failed to init
             q_return = xQueueReceive(q, &received_event, 0);  // check if there is a new mode, if not, we just use the last mode
@@ -546,7 +700,6 @@ void task_audio_code(void *parameter) {
             if (q_return == pdTRUE) {
                 switch (received_event.event_type) {
                     case EVENT_MODE_CHANGED:
-                        last_mode = curr_mode;
                         curr_mode = received_event.mode;
                         break;
                     default:
@@ -556,58 +709,158 @@ void task_audio_code(void *parameter) {
             if (curr_mode.main.id() == MODE_MAIN_AUDIO) {
                 int audio_mode = curr_mode.sub.id();
 
-                run_audio(&ap, audio_mode);
+                frame.capture_us = run_audio(&ap, audio_mode);
+                frame.seq = seq++;
+                frame.audio_mode = audio_mode;
+                frame.tempo = ap.get_tempo();
+                frame.beat_phase = ap.get_beat_phase();
+                memcpy(frame.intensity, ap.get_intensity(), sizeof(frame.intensity));
 
-                xSemaphoreTake(mutex_leds, portMAX_DELAY);
-                // Blend with the last image on the led before we changed modes
-                if (blend_counter == 0) {  // if the counter reset to 0 it means we changed modes
-                    lp.copy_leds(last_leds, NUM_LEDS);
-                    // calculate the number of cycles to take to fully blend based on servo move time, note this changes based on the mode change
-                    servo_pos_delta = abs(curr_mode.sub.get_servo_pos() - last_mode.sub.get_servo_pos());
-                    max_blend_count = int((SERVO_CYCLE_TIME_MS / 1000.0 * servo_pos_delta) * FPS * 1.25);
-                }
+                audio_frames.push(frame);      // if the queue is full the frame is dropped, which the render task sees as a gap in seq
+                xTaskNotifyGive(task_render);  // wake the render task
+            }
+        }
+        vTaskDelay(1);  // TODO: check this
+    }
 
-                if (last_audio_mode != audio_mode) {
-                    lp.set_audio_pattern(audio_mode);
-                }
-                last_audio_mode = audio_mode;
+    vTaskDelete(NULL);
+}
 
-                lp.display_audio(ap.get_intensity());
+// Renders the newest audio frame from the audio task to the LEDs and shows it
+void task_render_code(void *parameter) {
+    print("task_render_code running on core ");
+    print("%d\n", xPortGetCoreID());
 
-                if (blend_counter <= max_blend_count) {
-                    for (int i = 0; i < NUM_LEDS; i++) {
-                        int blend_factor = (float)blend_counter / max_blend_count * 255;  // int(round(pow(float(blend_counter) / max_blend_count, 2.2) * 255));
-                        lp.set(i, blend(last_leds[i], lp.get(i), blend_factor));
-                    }
-                    blend_counter += 1;
-                }
+#ifdef PROFILE_AUDIO
+    static Profiler profiler("render");  // total is the latency from audio capture to LEDs published, count is dropped frames
+#endif
 
-                xSemaphoreGive(mutex_leds);
+    static AudioFrame_t frame;       // static to keep it off the task stack
+    uint32_t last_seq = UINT32_MAX;  // sequence number of the last frame rendered or discarded
 
-                e = {.event_type = EVENT_AUDIO_FRAME_DONE};
-                eh.emit(e);
-            } else {
-                blend_counter = 0;  // reset the blend counter
+    BaseType_t q_return;
+    bool start_blend = true;  // true until the first frame after changing modes, which starts a cross-fade
+
+    QueueHandle_t q = (QueueHandle_t)parameter;  // q for receiving events
+    event_t received_event = {};
+    curr_mode_t curr_mode, last_mode;
+
+    q_return = xQueueReceive(q, &received_event, portMAX_DELAY);  // wait for start signal
+    if (q_return == pdTRUE && received_event.event_type == EVENT_START) {
+        print("Starting task\n");
+    }
+
+    q_return = xQueueReceive(q, &received_event, portMAX_DELAY);  // at the start, wait until we get a mode indication
+    if (q_return == pdTRUE && received_event.event_type == EVENT_MODE_CHANGED) {
+        curr_mode = received_event.mode;
+    } else {
+        print("WARNING: Did not get a valid initial mode!\n");
+    }
+
+    int last_audio_mode = -1;
+    for (;;) {
+        // Outside of audio mode there is nothing to render, so block until the mode changes
+        TickType_t q_wait = (curr_mode.main.id() == MODE_MAIN_AUDIO) ? 0 : portMAX_DELAY;
+        q_return = xQueueReceive(q, &received_event, q_wait);
+
+        if (q_return == pdTRUE) {
+            switch (received_event.event_type) {
+                case EVENT_MODE_CHANGED:
+                    last_mode = curr_mode;
+                    curr_mode = received_event.mode;
+                    break;
+                default:
+                    print("WARNING: task_render_code received unexpected event type %d!\n", received_event.event_type);
             }
         }
-        vTaskDelay(1);  // TODO: check this
-        // taskYIELD();  // yield first in case the next line doesn't actually delay
-        // vTaskDelayUntil(&xLastWakeTime, xFrequency);
+
+        if (curr_mode.main.id() != MODE_MAIN_AUDIO) {
+            start_blend = true;
+            while (audio_frames.pop(frame)) {  // discard stale frames
+                last_seq = frame.seq;
+            }
+            continue;
+        }
+
+        ulTaskNotifyTake(pdTRUE, AUDIO_FRAME_TIMEOUT_MS / portTICK_RATE_MS);  // wait for the audio task to push a frame
+
+        // Skip ahead to the newest frame to keep latency low
+        bool got_frame = false;
+        while (audio_frames.pop(frame)) {
+            got_frame = true;
+        }
+        if (!got_frame) {
+            continue;
+        }
+
+#ifdef PROFILE_AUDIO
+        profiler.begin_frame(frame.capture_us);
+        profiler.count(frame.seq - last_seq - 1);  // frames dropped or skipped since the last one rendered
+#endif
+        PROFILE_AUDIO_MARK("queue");
+        last_seq = frame.seq;
+
+        int audio_mode = frame.audio_mode;
+
+        xSemaphoreTake(mutex_leds, portMAX_DELAY);
+        // Blend with the last image on the led before we changed modes
+        if (start_blend) {
+            // take a little longer to fully blend than the servo takes to move, note this changes based on the mode change
+            int servo_pos_delta = abs(curr_mode.sub.get_servo_pos() - last_mode.sub.get_servo_pos());
+            start_transition(SERVO_CYCLE_TIME_MS * servo_pos_delta * 5 / 4, Compositor::CURVE_LINEAR);
+            start_blend = false;
+        }
+
+        if (last_audio_mode != audio_mode) {
+            lp.set_audio_pattern(audio_mode);
+        }
+        last_audio_mode = audio_mode;
+
+        lp.display_audio(frame.intensity, frame.tempo, frame.beat_phase);
+        comp.composite();
+
+        xSemaphoreGive(mutex_leds);
+        PROFILE_AUDIO_MARK("render");
+
+        show_leds();
+        PROFILE_AUDIO_MARK("publish");
+
+#ifdef PROFILE_AUDIO
+        profiler.end_frame();
+#endif
     }
 
     vTaskDelete(NULL);
 }
 
-void run_audio(AudioProcessor *ap, int audio_mode) {
+// Runs the audio pipeline for one frame, returning the time (from micros()) at which the newest sample was captured
+unsigned long run_audio(AudioProcessor *ap, int audio_mode) {
+#ifdef PROFILE_AUDIO
+    static Profiler profiler("audio");
+    profiler.begin_frame();
+#endif
+
     ap->get_audio_samples_gapless();
+    unsigned long capture_us = micros();
+    PROFILE_AUDIO_MARK("samples");
     ap->update_volume();
+    PROFILE_AUDIO_MARK("volume");
     ap->run_fft();
+    PROFILE_AUDIO_MARK("fft");
 
+    ap->set_filterbank(AUDIO_FILTERBANK[audio_mode]);
     if (audio_mode == MODE_AUDIO_SNAKE_GRID) {
         ap->calc_intensity(NUM_LEDS / 2);  // for a symmetric pattern, we only calculate intensities for half the LEDs
     } else {
         ap->calc_intensity_simple();
     }
+    PROFILE_AUDIO_MARK("intensity");
+
+#ifdef PROFILE_AUDIO
+    profiler.end_frame();
+#endif
+
+    return capture_us;
 }
 
 void task_spotify_code(void *parameter) {
@@ -657,7 +910,9 @@ void task_spotify_code(void *parameter) {
                 sp.update();
                 Spotify::public_data_t sp_data = sp.get_data();
                 if (sp_data.art_changed && sp_data.is_active) {  // only update art if spotify is active
-                    decode_art(sp_data.art_data, sp_data.art_num_bytes);
+                    char art_url[CLI_MAX_CHARS];
+                    sp.get_art_url(art_url);
+                    decode_art(sp_data.art_data, sp_data.art_num_bytes, art_url);
                 }
 
                 event_t e = {.event_type = EVENT_SPOTIFY_UPDATED, {.sp_data = sp_data}};
@@ -774,7 +1029,9 @@ void task_mode_code(void *parameter) {
                     vTaskDelay((servo_pos_delta * SERVO_CYCLE_TIME_MS) / portTICK_RATE_MS);  // wait for servo move
 
                     print("Clearing display\n");
-                    FastLED.clear(true);  // in case display got activated
+                    lp.clear();  // in case display got activated, we already hold mutex_leds so show directly
+                    lp.publish();
+                    lp.show();
 
                     print("Unmounting filesystem\n");
                     SPIFFS.end();
@@ -978,6 +1235,13 @@ void task_servo_code(void *parameter) {
 }
 
 void display_full_art(uint8_t offset_row, uint8_t offset_col) {
+#ifndef ART_FULL_RES
+    for (int row = 0; row < GRID_H; row++) {
+        for (int col = 0; col < GRID_W; col++) {
+            lp.set_xy_unchecked(col, GRID_H - 1 - row, album_art.art_crgb[row][col]);  // art rows start at the top
+        }
+    }
+#else
     // static int counter_static = 0;
     // static int offset_row_static = 0;
     // static int offset_col_static = 0;
@@ -999,68 +1263,114 @@ void display_full_art(uint8_t offset_row, uint8_t offset_col) {
             if (row == GRID_H - 1) full_row = GRID_H * 4 - 1;
             if (col == GRID_W - 1) full_col = GRID_W * 4 - 1;
 
-            uint16_t rgb565 = album_art.full_art_rgb565[full_row][full_col];
-
-            uint8_t r5 = (rgb565 >> 11) & 0x1F;
-            uint8_t g6 = (rgb565 >> 5) & 0x3F;
-            uint8_t b5 = (rgb565)&0x1F;
-
-            uint8_t r8 = round(pow(float(r5) / 31, LED_GAMMA_R / JPG_GAMMA) * 255);
-            uint8_t g8 = round(pow(float(g6) / 63, LED_GAMMA_G / JPG_GAMMA) * 255);
-            uint8_t b8 = round(pow(float(b5) / 31, LED_GAMMA_B / JPG_GAMMA) * 255);
-
-            // Serial.println(r5);
-            // Serial.println(g6);
-            // Serial.println(b5);
-
-            // Serial.println(r8);
-            // Serial.println(g8);
-            // Serial.println(b8);
-
-            // Serial.println();
-
-            int idx = lp.grid_to_idx(col, row, true);
-            if (idx >= 0) {
-                lp.set(idx, blend(lp.get(idx), CRGB(r8, g8, b8), int(round(LED_SMOOTHING * 0.25 * 255))));
-            }
+            lp.set_xy_unchecked(col, GRID_H - 1 - row, album_art.full_art_crgb[full_row][full_col]);  // art rows start at the top
         }
     }
+#endif
 }
 
 bool copy_jpg_data(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap) {
+    art_sampler.add_block(x, y, w, h, bitmap);  // average into the LEDs and sample for the palette
+
+#ifdef ART_FULL_RES
+    // Map the pixels onto the 64x64 full_art by their position in the image, as ArtSampler does, so art decoded
+    // larger than 64x64 is point sampled rather than cropped. Each full_art pixel takes the decoded pixel at
+    // (full_row * src_h / 64, full_col * src_w / 64), so this pixel fills the full_art rows and cols that map to it.
     for (int row = 0; row < h; row++) {
+        int src_y = y + row;
+        if (src_y >= full_art_src_h) {
+            continue;
+        }
+        int full_row_start = (src_y * 64 + full_art_src_h - 1) / full_art_src_h;
+        int full_row_end = ((src_y + 1) * 64 + full_art_src_h - 1) / full_art_src_h;
+
         for (int col = 0; col < w; col++) {
-            uint8_t full_row = y + row;
-            uint8_t full_col = x + col;
-            uint8_t bitmap_idx = row * w + col;
-            album_art.full_art_rgb565[full_row][full_col] = bitmap[bitmap_idx];  // copy full 64x64 image into full_art
-            if ((full_row % 4 == 0) && (full_col % 4 == 0)) {
-                album_art.palette_art_rgb565[int(full_row / 4)][int(full_col / 4)] = bitmap[bitmap_idx];  // copy a decimated version for palette calc
+            int src_x = x + col;
+            if (src_x >= full_art_src_w) {
+                continue;
+            }
+            int full_col_start = (src_x * 64 + full_art_src_w - 1) / full_art_src_w;
+            int full_col_end = ((src_x + 1) * 64 + full_art_src_w - 1) / full_art_src_w;
+            if (full_row_start == full_row_end || full_col_start == full_col_end) {
+                continue;  // not sampled
+            }
+
+            CRGB crgb = rgb565_to_led_crgb(bitmap[row * w + col]);
+            for (int full_row = full_row_start; full_row < full_row_end; full_row++) {
+                for (int full_col = full_col_start; full_col < full_col_end; full_col++) {
+                    album_art.full_art_crgb[full_row][full_col] = crgb;
+                }
             }
         }
     }
+#endif
 
     return true;
 }
 
-// Decode art from jpg into full_art, and calculate palette
-void decode_art(uint8_t *art_data, unsigned long art_num_bytes) {
+// Decode art from jpg into art_crgb, and calculate palette (or use the cached one for art_url)
+void decode_art(uint8_t *art_data, unsigned long art_num_bytes, const char *art_url) {
     print("Decoding art, %d bytes\n", art_num_bytes);
 
-    TJpgDec.setJpgScale(1);                          // no rescaling
+    // Decode at the smallest scale (1/1 to 1/8) that leaves enough pixels for the LEDs and the palette
+#ifdef ART_FULL_RES
+    const int min_w = 64;
+    const int min_h = 64;
+#else
+    const int min_w = max(GRID_W, PALETTE_ART_SIZE);
+    const int min_h = max(GRID_H, PALETTE_ART_SIZE);
+#endif
+    uint16_t w = 0, h = 0;
+    TJpgDec.getJpgSize(&w, &h, art_data, art_num_bytes);
+    uint8_t scale = 1;
+    while (scale < 8 && w / (scale * 2) >= min_w && h / (scale * 2) >= min_h) {
+        scale *= 2;
+    }
+    print("Art is %dx%d, decoding at 1/%d scale\n", w, h, scale);
+
+    art_sampler.begin(w / scale, h / scale);
+#ifdef ART_FULL_RES
+    full_art_src_w = w / scale;
+    full_art_src_h = h / scale;
+#endif
+    TJpgDec.setJpgScale(scale);
     TJpgDec.setCallback(copy_jpg_data);              // The decoder must be given the exact name of the rendering function above
-    TJpgDec.drawJpg(0, 0, art_data, art_num_bytes);  // decode and copy jpg data into full_art
-
-    // Calculate color palette
-    uint8_t palette_results_rgb888[PALETTE_ENTRIES][3] = {0};
-    mean_cut((uint16_t *)album_art.palette_art_rgb565, 16 * 16, MEAN_CUT_DEPTH, (uint8_t *)palette_results_rgb888);
-    print("Finished mean cut, printing returned results\n");
-    for (int i = 0; i < PALETTE_ENTRIES; i++) {
-        print("%d, %d, %d\n", palette_results_rgb888[i][0], palette_results_rgb888[i][1], palette_results_rgb888[i][2]);
-        uint8_t r8 = round(pow(float(palette_results_rgb888[i][0]) / 255, LED_GAMMA_R / JPG_GAMMA) * 255);
-        uint8_t g8 = round(pow(float(palette_results_rgb888[i][1]) / 255, LED_GAMMA_G / JPG_GAMMA) * 255);
-        uint8_t b8 = round(pow(float(palette_results_rgb888[i][2]) / 255, LED_GAMMA_B / JPG_GAMMA) * 255);
-        album_art.palette_crgb[i] = CRGB(r8, g8, b8);
+    TJpgDec.drawJpg(0, 0, art_data, art_num_bytes);  // decode and downsample jpg data into art_crgb
+    art_sampler.finish((CRGB *)album_art.art_crgb);
+
+    // Look for the palette in the cache before calculating it. Urls too long to store whole are never cached, as a
+    // truncated url could match the wrong art.
+    bool cacheable = (art_url[0] != '\0') && (strnlen(art_url, CLI_MAX_CHARS) < CLI_MAX_CHARS);
+    bool cached = false;
+    for (int i = 0; cacheable && i < PALETTE_CACHE_ENTRIES; i++) {
+        if (strncmp(palette_cache[i].art_url, art_url, CLI_MAX_CHARS) == 0) {
+            print("Using cached palette\n");
+            memcpy(album_art.palette_crgb, palette_cache[i].palette_crgb, sizeof(album_art.palette_crgb));
+            cached = true;
+            break;
+        }
+    }
+
+    if (!cached) {
+        // Calculate color palette
+        uint8_t palette_results_rgb888[PALETTE_ENTRIES][3] = {0};
+#ifdef PALETTE_MEAN_CUT_ONLY
+        mean_cut((uint16_t *)album_art.palette_art_rgb565, PALETTE_ART_SIZE * PALETTE_ART_SIZE, MEAN_CUT_DEPTH, (uint8_t *)palette_results_rgb888);
+#else
+        oklab_palette((uint16_t *)album_art.palette_art_rgb565, PALETTE_ART_SIZE * PALETTE_ART_SIZE, MEAN_CUT_DEPTH, (uint8_t *)palette_results_rgb888);
+#endif
+        print("Finished palette, printing returned results\n");
+        for (int i = 0; i < PALETTE_ENTRIES; i++) {
+            print("%d, %d, %d\n", palette_results_rgb888[i][0], palette_results_rgb888[i][1], palette_results_rgb888[i][2]);
+            album_art.palette_crgb[i] = rgb888_to_led_crgb(palette_results_rgb888[i]);
+        }
+
+        if (cacheable) {
+            PaletteCacheEntry_t &entry = palette_cache[palette_cache_next];
+            strncpy(entry.art_url, art_url, CLI_MAX_CHARS);
+            memcpy(entry.palette_crgb, album_art.palette_crgb, sizeof(entry.palette_crgb));
+            palette_cache_next = (palette_cache_next + 1) % PALETTE_CACHE_ENTRIES;
+        }
     }
 
     lp.set_target_palette(CRGBPalette16(album_art.palette_crgb[0], album_art.palette_crgb[1], album_art.palette_crgb[2], album_art.palette_crgb[3],
@@ -1153,8 +1463,6 @@ void display_image(const char *filepath) {
     }
 
     TJpgDec.drawFsJpg(0, 0, filepath);
-
-    FastLED.show();
 }
 
 // Display image directly to LEDs
@@ -1165,26 +1473,7 @@ bool display_jpg_data(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bi
 
     for (int row = 0; row < h; row++) {
         for (int col = 0; col < w; col++) {
-            uint16_t rgb565 = bitmap[row * w + col];
-            uint8_t r5 = (rgb565 >> 11) & 0x1F;
-            uint8_t g6 = (rgb565 >> 5) & 0x3F;
-            uint8_t b5 = (rgb565)&0x1F;
-
-            uint8_t r8 = round((float(r5) / 31) * 255);
-            uint8_t g8 = round((float(g6) / 63) * 255);
-            uint8_t b8 = round((float(b5) / 31) * 255);
-
-            // Serial.println(r5);
-            // Serial.println(g6);
-            // Serial.println(b5);
-
-            // Serial.println(r8);
-            // Serial.println(g8);
-            // Serial.println(b8);
-
-            // Serial.println();
-
-            lp.set_xy(x + col, y + row, CRGB(r8, g8, b8), true);
+            lp.set_xy(x + col, y + row, rgb565_to_crgb(bitmap[row * w + col]), true);
         }
     }
 